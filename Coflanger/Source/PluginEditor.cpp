@@ -11,8 +11,10 @@
 
 //==============================================================================
 CoflangerAudioProcessorEditor::CoflangerAudioProcessorEditor (CoflangerAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p), mAnalyzerView (p.getAnalyzer())
 {
+    setOpaque(true);
+
     auto& params = processor.getParameters();
 
     juce::AudioParameterFloat* dryWetParameter = (juce::AudioParameterFloat*)params.getUnchecked(0);
@@ -26,6 +28,7 @@ CoflangerAudioProcessorEditor::CoflangerAudioProcessorEditor (CoflangerAudioProc
     mDryWetSlider.onValueChange = [this, dryWetParameter] {*dryWetParameter = mDryWetSlider.getValue(); };
     mDryWetSlider.onDragStart = [dryWetParameter] {dryWetParameter->beginChangeGesture(); };
     mDryWetSlider.onDragEnd = [dryWetParameter] {dryWetParameter->endChangeGesture(); };
+    mParameterSync.bind(mDryWetSlider, *dryWetParameter);
     //asd
     juce::AudioParameterFloat* depthParameter = (juce::AudioParameterFloat*)params.getUnchecked(1);
 
@@ -38,6 +41,7 @@ CoflangerAudioProcessorEditor::CoflangerAudioProcessorEditor (CoflangerAudioProc
     mDepthSlider.onValueChange = [this, depthParameter] {*depthParameter = mDepthSlider.getValue(); };
     mDepthSlider.onDragStart = [depthParameter] {depthParameter->beginChangeGesture(); };
     mDepthSlider.onDragEnd = [depthParameter] {depthParameter->endChangeGesture(); };
+    mParameterSync.bind(mDepthSlider, *depthParameter);
     //asd
     juce::AudioParameterFloat* rateParameter = (juce::AudioParameterFloat*)params.getUnchecked(2);
 
@@ -50,6 +54,7 @@ CoflangerAudioProcessorEditor::CoflangerAudioProcessorEditor (CoflangerAudioProc
     mRateSlider.onValueChange = [this, rateParameter] {*rateParameter = mRateSlider.getValue(); };
     mRateSlider.onDragStart = [rateParameter] {rateParameter->beginChangeGesture(); };
     mRateSlider.onDragEnd = [rateParameter] {rateParameter->endChangeGesture(); };
+    mParameterSync.bind(mRateSlider, *rateParameter);
     //asd
     juce::AudioParameterFloat* phaseOffsetParameter = (juce::AudioParameterFloat*)params.getUnchecked(3);
 
@@ -62,6 +67,7 @@ CoflangerAudioProcessorEditor::CoflangerAudioProcessorEditor (CoflangerAudioProc
     mPhaseOffsetSlider.onValueChange = [this, phaseOffsetParameter] {*phaseOffsetParameter = mPhaseOffsetSlider.getValue(); };
     mPhaseOffsetSlider.onDragStart = [phaseOffsetParameter] {phaseOffsetParameter->beginChangeGesture(); };
     mPhaseOffsetSlider.onDragEnd = [phaseOffsetParameter] {phaseOffsetParameter->endChangeGesture(); };
+    mParameterSync.bind(mPhaseOffsetSlider, *phaseOffsetParameter);
     //asd
     juce::AudioParameterFloat* feedbackParameter = (juce::AudioParameterFloat*)params.getUnchecked(4);
 
@@ -74,6 +80,7 @@ CoflangerAudioProcessorEditor::CoflangerAudioProcessorEditor (CoflangerAudioProc
     mFeedbackSlider.onValueChange = [this, feedbackParameter] {*feedbackParameter = mFeedbackSlider.getValue(); };
     mFeedbackSlider.onDragStart = [feedbackParameter] {feedbackParameter->beginChangeGesture(); };
     mFeedbackSlider.onDragEnd = [feedbackParameter] {feedbackParameter->endChangeGesture(); };
+    mParameterSync.bind(mFeedbackSlider, *feedbackParameter);
     //asd
     juce::AudioParameterInt* typeParameter = (juce::AudioParameterInt*)params.getUnchecked(5);
 
@@ -85,9 +92,14 @@ CoflangerAudioProcessorEditor::CoflangerAudioProcessorEditor (CoflangerAudioProc
         typeParameter->endChangeGesture();
     };
     addAndMakeVisible(mType);
+    mParameterSync.bind(*typeParameter, [this, typeParameter] { mType.setSelectedItemIndex(typeParameter->get(), juce::dontSendNotification); });
+
+    addAndMakeVisible(mAnalyzerView);
 
+    mParameterSync.updateAll();
 
-    setSize (400, 300);
+    setSize (designWidth, designHeight);
+    EditorRendering::makeResizable(*this);
 }
 
 CoflangerAudioProcessorEditor::~CoflangerAudioProcessorEditor()
@@ -96,10 +108,17 @@ CoflangerAudioProcessorEditor::~CoflangerAudioProcessorEditor()
 
 //==============================================================================
 void CoflangerAudioProcessorEditor::paint (juce::Graphics& g)
+{
+    mStaticLayer.draw(g, getLocalBounds(), [this] (juce::Graphics& layer) { paintStaticLayer(layer); });
+}
+
+void CoflangerAudioProcessorEditor::paintStaticLayer (juce::Graphics& g)
 {
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
 
+    g.addTransform(EditorRendering::DesignScale(*this, designWidth).getTransform());
+
     g.setColour (juce::Colours::white);
     g.setFont (15.0f);
 
@@ -112,10 +131,14 @@ void CoflangerAudioProcessorEditor::paint (juce::Graphics& g)
 
 void CoflangerAudioProcessorEditor::resized()
 {
-    mDryWetSlider.setBounds(0, 0, 100, 100);
-    mDepthSlider.setBounds(100, 0, 100, 100);
-    mRateSlider.setBounds(200, 0, 100, 100);
-    mPhaseOffsetSlider.setBounds(300, 0, 100, 100);
-    mFeedbackSlider.setBounds(0, 100, 100, 100);
-    mType.setBounds(250, 150, 80, 30);
+    const EditorRendering::DesignScale scaled (*this, designWidth);
+
+    mDryWetSlider.setBounds(scaled(0, 0, 100, 100));
+    mDepthSlider.setBounds(scaled(100, 0, 100, 100));
+    mRateSlider.setBounds(scaled(200, 0, 100, 100));
+    mPhaseOffsetSlider.setBounds(scaled(300, 0, 100, 100));
+    mFeedbackSlider.setBounds(scaled(0, 100, 100, 100));
+    mType.setBounds(scaled(250, 150, 80, 30));
+
+    mAnalyzerView.setBounds(scaled(0, 250, 400, 150));
 }
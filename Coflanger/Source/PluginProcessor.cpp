@@ -8,6 +8,14 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "../../Shared/RealtimeGuard.h"
+#include "../../Shared/TraceEvents.h"
+
+// tools that link several plugins into one binary (JUCE_PROJECTS_MULTI_PLUGIN_BUILD)
+// provide the allocator hooks and their own entry point once, themselves
+#if ! JUCE_PROJECTS_MULTI_PLUGIN_BUILD
+ #include "../../Shared/RealtimeGuardAllocators.h"
+#endif
 
 //==============================================================================
 CoflangerAudioProcessor::CoflangerAudioProcessor()
@@ -34,28 +42,39 @@ CoflangerAudioProcessor::CoflangerAudioProcessor()
 
     addParameter(mTypeParameter = new juce::AudioParameterInt("type", "Type", 0, 1, 1));
 
-    mCircularBufferLeft = nullptr;
-    mCircularBufferRight = nullptr;
+    addParameter(mQualityParameter = new QualityLevelParameter(maxQualityLevel));
+    mQualityPublisher = std::make_unique<QualityLevelPublisher>(mGovernor, *mQualityParameter);
+
+    // in FractionalDelay::Interpolation order; Allpass suits the slow sweeps of the flanger best
+    addParameter(mInterpolationParameter = new juce::AudioParameterChoice("interpolation", "Interpolation",
+                                                                          { "Linear", "Hermite", "Allpass", "Sinc 8", "Sinc 16" }, 0));
+
+    mPresets = std::make_unique<PresetBank>(*this, 5);
+    mPresets->setPreset(1, "Subtle Chorus", { { "drywet", 0.4f }, { "depth", 0.3f }, { "rate", 0.8f }, { "phaseoffset", 0.25f }, { "feedback", 0.1f }, { "type", 0.0f } });
+    mPresets->setPreset(2, "Wide Chorus", { { "drywet", 0.5f }, { "depth", 0.6f }, { "rate", 1.5f }, { "phaseoffset", 0.5f }, { "feedback", 0.2f }, { "type", 0.0f } });
+    mPresets->setPreset(3, "Jet Flanger", { { "drywet", 0.5f }, { "depth", 0.9f }, { "rate", 0.2f }, { "feedback", 0.85f }, { "type", 1.0f }, { "interpolation", 2.0f } });
+    mPresets->setPreset(4, "Metallic", { { "drywet", 0.6f }, { "depth", 0.4f }, { "rate", 6.0f }, { "feedback", 0.95f }, { "type", 1.0f }, { "interpolation", 2.0f } });
+
+    mKernels = &CpuDispatch::getKernels();
+
     mCircularBufferWriteHead = 0;
     mCircularBufferLength = 0;
+    mDelayLineStride = 0;
+    mNumDelayLines = 0;
 
-    mFeedbackLeft = 0.0;
-    mFeedbackRight = 0.0;
+    for (auto& channelFeedback : mFeedback)
+        channelFeedback = 0.0f;
 
+    for (auto& state : mAllpassState)
+        state = 0.0f;
 
-    mLFOPhaseL = 0.0;
+
+    mLFOPhaseL = 0.0f;
     mLFOPhaseR = 0.0;
 }
 
 CoflangerAudioProcessor::~CoflangerAudioProcessor()
 {
-    if (mCircularBufferLeft != nullptr) {
-        delete[] mCircularBufferLeft;
-    }
-
-    if (mCircularBufferRight != nullptr) {
-        delete[] mCircularBufferRight;
-    }
 }
 
 //==============================================================================
@@ -98,81 +117,111 @@ double CoflangerAudioProcessor::getTailLengthSeconds() const
 
 int CoflangerAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return mPresets->getNumPresets();
 }
 
 int CoflangerAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return mPresets->getCurrentPreset();
 }
 
 void CoflangerAudioProcessor::setCurrentProgram (int index)
 {
+    // morphs there from the audio thread, no parameter is touched until it arrives
+    mPresets->select(index);
 }
 
 const juce::String CoflangerAudioProcessor::getProgramName (int index)
 {
-    return {};
+    return mPresets->getName(index);
 }
 
 void CoflangerAudioProcessor::changeProgramName (int index, const juce::String& newName)
 {
+    mPresets->setName(index, newName);
 }
 
 //==============================================================================
 void CoflangerAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
+    TRACE_SCOPE ("Coflanger::prepareToPlay");
+
+    // in fixed block mode the DSP only ever sees blocks of that size, a block late
+    samplesPerBlock = mFixedBlocks.prepare(juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()), samplesPerBlock);
+    setLatencySamples(mFixedBlocks.getLatencySamples());
+
+    mPresets->prepare(sampleRate);
+    mAnalyzer.prepare(sampleRate);
+    mBypass.prepare(sampleRate, juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()));
+
+    mCapture.startFromEnvironment (*this, sampleRate, samplesPerBlock);
+
     //mDelayTimeInSamples = *mDelayTimeParameter * sampleRate;//not needed here
     //mDelayTimeSmoothed = *mDelayTimeParameter;
 
 
 
-    if (mCircularBufferLeft != nullptr) {
-        delete[] mCircularBufferLeft;
-        mCircularBufferLeft = new float[sampleRate * MAX_DELAY_TIME];
-        for (int i = 0; i < sampleRate * MAX_DELAY_TIME; i++)
-        {
-            mCircularBufferLeft[i] = 0.0;
-        }
-    }
+    const int numChannels = juce::jmin(getTotalNumInputChannels(), MAX_CHANNELS);
 
-    if (mCircularBufferLeft == nullptr) {
-        mCircularBufferLeft = new float[sampleRate * MAX_DELAY_TIME];
-        for (int i = 0; i < sampleRate * MAX_DELAY_TIME; i++)
-        {
-            mCircularBufferLeft[i] = 0.0;
-        }
-    }
+    mCircularBufferLength = MAX_DELAY_TIME * sampleRate;
+    mCircularBufferWriteHead = 0;
+    mNumDelayLines = numChannels;
+    mDelayLineStride = DelayMemoryPool::getAlignedStride<float>(FractionalDelay::getStorageSize(mCircularBufferLength));
 
-    if (mCircularBufferRight != nullptr) {
-        delete[] mCircularBufferRight;
-        mCircularBufferRight = new float[sampleRate * MAX_DELAY_TIME];
-        for (int i = 0; i < sampleRate * MAX_DELAY_TIME; i++)
-        {
-            mCircularBufferRight[i] = 0.0;
-        }
-    }
+    // given back first, so a re-prepare can get the same block again
+    mDelayMemory.reset();
+    mDelayMemory = mDelayMemoryPool->lease((size_t) numChannels * (size_t) mDelayLineStride * sizeof(float));
 
-    if (mCircularBufferRight == nullptr) {
-        mCircularBufferRight = new float[sampleRate * MAX_DELAY_TIME];
-        for (int i = 0; i < sampleRate * MAX_DELAY_TIME; i++)
-        {
-            mCircularBufferRight[i] = 0.0;
-        }
+    // over the pool's budget: no delay lines, audio passes through untouched
+    if (! mDelayMemory.isValid()) {
+        mCircularBufferLength = 0;
+        mNumDelayLines = 0;
     }
-    mCircularBufferLength = MAX_DELAY_TIME * sampleRate;
-    mCircularBufferWriteHead = 0;
+
+    for (auto& channelFeedback : mFeedback)
+        channelFeedback = 0.0f;
+
+    for (auto& state : mAllpassState)
+        state = 0.0f;
 
     
-    mLFOPhaseL = 0.0;
-    mLFOPhaseR = 0.0;
+    mLFOPhaseL = 0.0f;
+    mLFOPhaseR = *mPhaseOffsetParameter;
+
+    const double initialDelayTimes[] = {
+        (double) getLfoDelayTime(mLFOPhaseL, *mDepthParameter, *mTypeParameter, (float) sampleRate),
+        (double) getLfoDelayTime(mLFOPhaseR, *mDepthParameter, *mTypeParameter, (float) sampleRate)
+    };
+    mReadHeads.reset(mCircularBufferLength, mCircularBufferWriteHead, CONTROL_INTERVAL, initialDelayTimes);
+
+    const float initialAutomation[numAutomationLanes] = {
+        *mDryWetParameter, *mDepthParameter, *mRateParameter, *mPhaseOffsetParameter, *mFeedbackParameter
+    };
+    mAutomation.reset(initialAutomation);
+
+    // read positions for the LEFT/RIGHT LFO phases
+    mReadPositions.resize(2 * (size_t) samplesPerBlock);
+
+    std::get<juce::AudioBuffer<float>>(mWetBuffers).setSize(numChannels, isUsingDoublePrecision() ? 0 : samplesPerBlock);
+    std::get<juce::AudioBuffer<double>>(mWetBuffers).setSize(numChannels, isUsingDoublePrecision() ? samplesPerBlock : 0);
+
+    // only used by offline renders, so realtime playback never waits on it
+    mChannelPool = mParallelChannels ? ChannelThreadPool::createForChannels(numChannels) : nullptr;
+
+    mGovernor.prepare(sampleRate, maxQualityLevel);
 }
 
 void CoflangerAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    mCapture.stop();
+    mChannelPool.reset();
+
+    // back to the shared pool until the next prepareToPlay
+    mDelayMemory.reset();
+    mCircularBufferLength = 0;
+    mNumDelayLines = 0;
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -182,12 +231,11 @@ bool CoflangerAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Every channel is modulated on its own (even channels follow the LEFT
+    // LFO phase, odd ones the RIGHT), so any layout up to MAX_CHANNELS works,
+    // including the wide stems of offline bounces.
+    if (layouts.getMainOutputChannelSet().isDisabled()
+     || layouts.getMainOutputChannelSet().size() > MAX_CHANNELS)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -203,7 +251,56 @@ bool CoflangerAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
 
 void CoflangerAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    process(buffer, midiMessages, false);
+}
+
+void CoflangerAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(buffer, midiMessages, false);
+}
+
+void CoflangerAudioProcessor::processBlockBypassed (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(buffer, midiMessages, true);
+}
+
+void CoflangerAudioProcessor::processBlockBypassed (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(buffer, midiMessages, true);
+}
+
+bool CoflangerAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
+template <typename FloatType>
+void CoflangerAudioProcessor::process (juce::AudioBuffer<FloatType>& buffer, juce::MidiBuffer& midiMessages, bool bypassed)
+{
+    // everything from here on runs on the audio thread, the bypass fade and
+    // the keep-alive path included
+    RealtimeGuard::ScopedAudioThread realtimeGuard;
     juce::ScopedNoDenormals noDenormals;
+
+    // once per host block, bypassed ones included, before fixed blocks or the
+    // bypass fade cut it up: a replay then makes the same calls
+    mCapture.captureBlock (buffer, getParameters(), bypassed);
+
+    mAnalyzer.pushInput(buffer);
+
+    mFixedBlocks.process(buffer, [&] (juce::AudioBuffer<FloatType>& block) {
+        mBypass.process(block, bypassed, [&] (juce::AudioBuffer<FloatType>& part) { processEffect(part, midiMessages); },
+                                         [&] (juce::AudioBuffer<FloatType>& part) { keepDelayLinesFed(part); });
+    });
+
+    mAnalyzer.pushOutput(buffer);
+}
+
+template <typename FloatType>
+void CoflangerAudioProcessor::processEffect (juce::AudioBuffer<FloatType>& buffer, juce::MidiBuffer& midiMessages)
+{
+    QualityGovernor::ScopedBlockTimer qualityTimer (mGovernor, buffer.getNumSamples());
+    TRACE_SCOPE ("Coflanger::processBlock");
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -213,84 +310,188 @@ void CoflangerAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, ju
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    float* leftChannel = buffer.getWritePointer(0);
-    float* rightChannel = buffer.getWritePointer(1);
+    if (mCircularBufferLength == 0)
+        return;
+
+    float dryWet, depth, rate, phaseOffset, feedback;
+    int type;
+    FractionalDelay::Interpolation interpolation;
+
+    {
+        TRACE_SCOPE ("parameter snapshot");
+        mPresets->beginBlock(buffer.getNumSamples());
+        dryWet = mPresets->read(*mDryWetParameter);
+        depth = mPresets->read(*mDepthParameter);
+        rate = mPresets->read(*mRateParameter);
+        phaseOffset = mPresets->read(*mPhaseOffsetParameter);
+        feedback = mPresets->read(*mFeedbackParameter);
+        type = mPresets->read(*mTypeParameter);
+        interpolation = (FractionalDelay::Interpolation) mPresets->read(*mInterpolationParameter);
+    }
+
+    const float automationTargets[numAutomationLanes] = { dryWet, depth, rate, phaseOffset, feedback };
+    mAutomation.beginBlock(automationTargets, buffer.getNumSamples());
+
+    const float sampleRate = (float) getSampleRate();
+    const int numChannels = juce::jmin(totalNumInputChannels, mNumDelayLines);
+
+    // channels only share the read-only LFO read positions, so offline renders
+    // can spread them over the pool
+    const bool processChannelsInParallel = isNonRealtime() && mChannelPool != nullptr;
+
+    mGovernor.setRealtime(! isNonRealtime());
+
+    // the scratch buffers are sized in prepareToPlay, so longer host blocks are split up
+    auto& wetBuffer = std::get<juce::AudioBuffer<FloatType>>(mWetBuffers);
+    const int maxChunkSize = wetBuffer.getNumSamples();
+
+    if (maxChunkSize == 0)
+        return;
+
+    // ... and blocks in which a continuous parameter moved go in sub-blocks,
+    // each with its own step of mAutomation's ramp
+    int numSamples = 0;
+
+    for (int chunkStart = 0; chunkStart < buffer.getNumSamples(); chunkStart += numSamples)
+    {
+        numSamples = juce::jmin(maxChunkSize, mAutomation.getSubBlockLength(), buffer.getNumSamples() - chunkStart);
+
+        const int chunkEnd = chunkStart + numSamples;
+        dryWet = mAutomation.getValue(dryWetLane, chunkEnd);
+        depth = mAutomation.getValue(depthLane, chunkEnd);
+        rate = mAutomation.getValue(rateLane, chunkEnd);
+        phaseOffset = mAutomation.getValue(phaseOffsetLane, chunkEnd);
+        feedback = mAutomation.getValue(feedbackLane, chunkEnd);
+
+        ReadHead::Position* readPositionsLeft = mReadPositions.data();
+        ReadHead::Position* readPositionsRight = mReadPositions.data() + mReadPositions.size() / 2;
 
-    for (int i = 0; i < buffer.getNumSamples(); i++) {
-        float lfoOutLeft = std::sin(juce::MathConstants<float>::twoPi * mLFOPhaseL);
-        float lfoOutRight = std::sin(juce::MathConstants<float>::twoPi * mLFOPhaseR);
-        //Add Chorus Depth
-        lfoOutLeft *= *mDepthParameter;
-        lfoOutRight *= *mDepthParameter;
+        const auto quality = mGovernor.getNextRamp(numSamples);
 
-        float lfoOutMappedLeft = 0.0;
-        float lfoOutMappedRight = 0.0;
+        mReadHeads.setInterval(quality.level >= coarseModulation ? COARSE_CONTROL_INTERVAL : CONTROL_INTERVAL);
 
-        //CHORUS
-        if (*mTypeParameter == 0) {
-            //Map lfo to delayTime
-            lfoOutMappedLeft = juce::jmap<float>(lfoOutLeft, -1.0, 1.0, 0.005f, 0.03f);
-            lfoOutMappedRight = juce::jmap<float>(lfoOutRight, -1.0, 1.0, 0.005f, 0.03f);
+        {
+            TRACE_SCOPE ("lfo");
+
+            ReadHead::Position* readPositions[] = { readPositionsLeft, readPositionsRight };
+
+            // the LFO and its mapping only run at control points, the read heads glide in between
+            mReadHeads.process(readPositions, numSamples, [&] (int intervalLength, double* targets) {
+                //LFO phase
+                mLFOPhaseL += intervalLength * rate / sampleRate;
+                //verify wrapping
+                if (mLFOPhaseL > 1.0f)
+                    mLFOPhaseL -= 1.0f;
+                mLFOPhaseR = mLFOPhaseL + phaseOffset;
+                if (mLFOPhaseR > 1)
+                    mLFOPhaseR -= 1;
+
+                targets[0] = (double) getLfoDelayTime(mLFOPhaseL, depth, type, sampleRate);
+                targets[1] = (double) getLfoDelayTime(mLFOPhaseR, depth, type, sampleRate);
+            });
+        }
+
+        auto processChannelChunk = [&] (int channel)
+        {
+            const ReadHead::Position* readPositions = channel % 2 == 0 ? readPositionsLeft : readPositionsRight;
+            processChannel(channel, buffer.getWritePointer(channel) + chunkStart, wetBuffer.getWritePointer(channel), readPositions,
+                           numSamples, (FloatType) feedback, (FloatType) dryWet, interpolation, quality);
+        };
+
+        if (processChannelsInParallel) {
+            mChannelPool->forEach(numChannels, processChannelChunk);
         }
-        else
-        {//FLANGER
-            //Map lfo to delayTime
-            lfoOutMappedLeft = juce::jmap<float>(lfoOutLeft, -1.0, 1.0, 0.001f, 0.005f);
-            lfoOutMappedRight = juce::jmap<float>(lfoOutRight, -1.0, 1.0, 0.001f, 0.005f);
+        else {
+            for (int channel = 0; channel < numChannels; channel++)
+                processChannelChunk(channel);
         }
 
-        
-
-        //calculate delayTime
-        float delayTimeSamplesLeft = lfoOutMappedLeft * getSampleRate();
-        float delayTimeSamplesRight = lfoOutMappedRight * getSampleRate();
-        //LFO phase
-        mLFOPhaseR = mLFOPhaseL + *mPhaseOffsetParameter;
-        mLFOPhaseL += *mRateParameter / getSampleRate();//first calculate then add up
-        //verify wrapping
-        if (mLFOPhaseL > 1.0)
-            mLFOPhaseL -= 1.0;
-        if (mLFOPhaseR > 1) {
-            mLFOPhaseR -= 1;
+        mCircularBufferWriteHead = (mCircularBufferWriteHead + numSamples) % mCircularBufferLength;
+    }
+}
+
+template <typename FloatType>
+void CoflangerAudioProcessor::keepDelayLinesFed (juce::AudioBuffer<FloatType>& buffer)
+{
+    TRACE_SCOPE ("Coflanger::keepDelayLinesFed");
+
+    if (mCircularBufferLength == 0)
+        return;
+
+    // bypassed, the delay lines take the dry input as it is: no feedback, nothing read
+    const int numChannels = juce::jmin(getTotalNumInputChannels(), mNumDelayLines);
+    const int maxChunkSize = juce::jmax(1, (int) mReadPositions.size() / 2);
+
+    for (int chunkStart = 0; chunkStart < buffer.getNumSamples(); chunkStart += maxChunkSize)
+    {
+        const int numSamples = juce::jmin(maxChunkSize, buffer.getNumSamples() - chunkStart);
+
+        for (int channel = 0; channel < numChannels; channel++) {
+            FractionalDelay::writeBlock(FractionalDelay::getRingStart(getDelayLine(channel)), mCircularBufferLength,
+                                        mCircularBufferWriteHead, buffer.getReadPointer(channel) + chunkStart, numSamples);
+            mFeedback[channel] = 0.0f;
         }
-        
-        mCircularBufferLeft[mCircularBufferWriteHead] = leftChannel[i] + mFeedbackLeft;
-        mCircularBufferRight[mCircularBufferWriteHead] = rightChannel[i] + mFeedbackRight;
 
-        float delayReadHeadLeft = mCircularBufferWriteHead - delayTimeSamplesLeft;
-        float delayReadHeadRight = mCircularBufferWriteHead - delayTimeSamplesRight;
-        //verify readheads for < 0
-        if (delayReadHeadLeft < 0)
-            delayReadHeadLeft += mCircularBufferLength;
-        if (delayReadHeadRight < 0)
-            delayReadHeadRight += mCircularBufferLength;
+        mCircularBufferWriteHead = (mCircularBufferWriteHead + numSamples) % mCircularBufferLength;
+        mReadHeads.skip(numSamples);
+    }
+}
 
-        //interpolation LEFT
-        int readHeadLeft_x = (int)delayReadHeadLeft;
-        int readHeadLeft_x1 = (readHeadLeft_x + 1) % mCircularBufferLength; //wrap around if not in interval
-        float readHeadFloatLeft = delayReadHeadLeft - readHeadLeft_x;
-        //interpolation RIGHT
-        int readHeadRight_x = (int)delayReadHeadRight;
-        int readHeadRight_x1 = (readHeadRight_x + 1) % mCircularBufferLength; //wrap around if not in interval
-        float readHeadFloatRight = delayReadHeadRight - readHeadRight_x;
+template <typename FloatType>
+void CoflangerAudioProcessor::processChannel (int channel, FloatType* channelData, FloatType* wet, const ReadHead::Position* readPositions,
+                                               int numSamples, FloatType feedback, FloatType dryWet,
+                                               FractionalDelay::Interpolation interpolation, const QualityGovernor::Ramp& quality)
+{
+    float* circularBuffer = FractionalDelay::getRingStart(getDelayLine(channel));
+    FloatType channelFeedback = (FloatType) mFeedback[channel];
+    float allpassState = mAllpassState[channel];
+    int writeHead = mCircularBufferWriteHead;
+
+    // only a fade to or from nearestSampleRead reads differently: coarseModulation
+    // already shows in readPositions, so a second read there would just step the
+    // allpass twice
+    const bool isCrossfadingRead = quality.isCrossfading()
+                                && (quality.level >= nearestSampleRead) != (quality.previousLevel >= nearestSampleRead);
+
+    {
+        // writing and reading are fused: with feedback, each written sample
+        // depends on the previous read
+        TRACE_SCOPE ("delay write/read");
+
+        for (int i = 0; i < numSamples; i++) {
+            FractionalDelay::write(circularBuffer, mCircularBufferLength, writeHead, (float) (channelData[i] + channelFeedback));
 
-        float delay_sample_left = lin_interp(mCircularBufferLeft[readHeadLeft_x], mCircularBufferLeft[readHeadLeft_x1], readHeadFloatLeft);
-        float delay_sample_right = lin_interp(mCircularBufferRight[readHeadRight_x], mCircularBufferRight[readHeadRight_x1], readHeadFloatRight);
+            // the allpass must step exactly once per sample, so the faded-from
+            // read gets its own copy of the state, kept only if that read is
+            // the interpolating one
+            float previousAllpassState = allpassState;
 
-        mFeedbackLeft = delay_sample_left * *mFeedbackParameter;
-        mFeedbackRight = delay_sample_right * *mFeedbackParameter;
+            wet[i] = (FloatType) readDelayLine(circularBuffer, readPositions[i], quality.level, interpolation, allpassState);
 
+            if (isCrossfadingRead) {
+                FloatType gain = (FloatType) quality.getGain(i, numSamples);
+                wet[i] = wet[i] * gain + (FloatType) readDelayLine(circularBuffer, readPositions[i], quality.previousLevel, interpolation, previousAllpassState) * (FloatType (1) - gain);
 
-        mCircularBufferWriteHead++;
+                if (quality.previousLevel < nearestSampleRead)
+                    allpassState = previousAllpassState;
+            }
 
-        if (mCircularBufferWriteHead >= mCircularBufferLength)
-            mCircularBufferWriteHead = 0;
+            channelFeedback = wet[i] * feedback;
 
-        leftChannel[i] = leftChannel[i] * (1.0 - *mDryWetParameter) + delay_sample_left * *mDryWetParameter;
-        rightChannel[i] = rightChannel[i] * (1.0 - *mDryWetParameter) + delay_sample_right * *mDryWetParameter;
+            writeHead++;
 
-        //buffer.setSample(0, i, buffer.getSample(0, i) * *mDryWetParameter + delay_sample_left * (1.0 - *mDryWetParameter));
-        //buffer.setSample(1, i, buffer.getSample(1, i) * *mDryWetParameter + delay_sample_right * (1.0 - *mDryWetParameter));
+            if (writeHead >= mCircularBufferLength)
+                writeHead = 0;
+        }
+    }
+
+    mFeedback[channel] = (float) channelFeedback;
+    mAllpassState[channel] = allpassState;
+
+    {
+        TRACE_SCOPE ("mix");
+
+        CpuDispatch::mix(*mKernels, channelData, wet, FloatType (1) - dryWet, dryWet, numSamples);
     }
 }
 
@@ -308,46 +509,76 @@ juce::AudioProcessorEditor* CoflangerAudioProcessor::createEditor()
 //==============================================================================
 void CoflangerAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-    std::unique_ptr<juce::XmlElement> xml(new juce::XmlElement("Coflanger"));
+    PluginState::write(*this, stateID, destData);
+}
 
-    xml->setAttribute("DryWet", *mDryWetParameter);
-    xml->setAttribute("Depth", *mDepthParameter);
-    xml->setAttribute("Rate", *mRateParameter);
-    xml->setAttribute("PhaseOffset", *mPhaseOffsetParameter);
-    xml->setAttribute("Feedback", *mFeedbackParameter);
-    xml->setAttribute("Type", *mTypeParameter);
+void CoflangerAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    TRACE_SCOPE ("Coflanger::setStateInformation");
 
-    copyXmlToBinary(*xml, destData);
+    // sessions saved before PluginState hold a copyXmlToBinary blob
+    if (! PluginState::read(*this, stateID, data, sizeInBytes))
+        PluginState::readLegacyXml(*this, data, sizeInBytes, "Coflanger");
 }
 
-void CoflangerAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+//==============================================================================
+Analyzer& CoflangerAudioProcessor::getAnalyzer()
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
-    std::unique_ptr<juce::XmlElement> xml(getXmlFromBinary(data, sizeInBytes));
-
-    if (xml.get() != nullptr && xml->hasTagName("Coflanger")) {
-        *mDryWetParameter = xml->getDoubleAttribute("DryWet");
-        *mDepthParameter = xml->getDoubleAttribute("Depth");
-        *mRateParameter = xml->getDoubleAttribute("Rate");
-        *mPhaseOffsetParameter = xml->getDoubleAttribute("PhaseOffset");
-        *mFeedbackParameter = xml->getDoubleAttribute("Feedback");
-        *mTypeParameter = xml->getDoubleAttribute("Type");
-    }
+    return mAnalyzer;
+}
+
+void CoflangerAudioProcessor::setParallelChannels(bool shouldProcessInParallel)
+{
+    mParallelChannels = shouldProcessInParallel;
+}
+
+void CoflangerAudioProcessor::setFixedBlockSize(int blockSize)
+{
+    mFixedBlocks.setBlockSize(blockSize);
+}
 
+float CoflangerAudioProcessor::getLfoDelayTime (float phase, float depth, int type, float sampleRate)
+{
+    //CHORUS or FLANGER delay range in seconds
+    const float minDelayTime = type == 0 ? 0.005f : 0.001f;
+    const float maxDelayTime = type == 0 ? 0.03f : 0.005f;
+
+    // sin(2 pi phase) from the shared wavetable; phase can reach exactly 1
+    const float position = phase * LFO_TABLE_SIZE;
+    const int index = (int)position;
+    const float fraction = position - index;
+    const float* sine = mLfoTable.getRow(index & (LFO_TABLE_SIZE - 1));
+    float lfoOut = sine[0] + fraction * (sine[1] - sine[0]);
+    //Add Chorus Depth
+    lfoOut *= depth;
+
+    //Map lfo to delayTime in samples
+    return juce::jmap<float>(lfoOut, -1.0f, 1.0f, minDelayTime, maxDelayTime) * sampleRate;
 }
 
-float CoflangerAudioProcessor::lin_interp(float sample_x, float sample_x1, float inPhase)
+float* CoflangerAudioProcessor::getDelayLine (int channel)
 {
-    return (1.0 - inPhase) * sample_x + inPhase * sample_x1;
+    return mDelayMemory.getAs<float>() + channel * mDelayLineStride;
+}
+
+float CoflangerAudioProcessor::readDelayLine (const float* circularBuffer, ReadHead::Position readHead, int qualityLevel,
+                                              FractionalDelay::Interpolation interpolation, float& allpassState)
+{
+    // the read head stays in [0, length), so its integer part indexes the ring as it is
+    const int readHead_x = ReadHead::getIndex(readHead);
+
+    if (qualityLevel >= nearestSampleRead)
+        return circularBuffer[readHead_x];
+
+    // the guard samples around the ring stand in for the wrap around
+    return FractionalDelay::read(mInterpolationTables, interpolation, circularBuffer, readHead_x, ReadHead::getFraction(readHead), allpassState);
 }
 
 //==============================================================================
+#if ! JUCE_PROJECTS_MULTI_PLUGIN_BUILD
 // This creates new instances of the plugin..
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 {
     return new CoflangerAudioProcessor();
 }
+#endif
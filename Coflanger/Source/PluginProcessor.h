@@ -9,12 +9,37 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "../../Shared/Analyzer.h"
+#include "../../Shared/AutomationCapture.h"
+#include "../../Shared/AutomationRamp.h"
+#include "../../Shared/BypassCrossfade.h"
+#include "../../Shared/ChannelThreadPool.h"
+#include "../../Shared/CpuDispatch.h"
+#include "../../Shared/DelayMemoryPool.h"
+#include "../../Shared/DspTables.h"
+#include "../../Shared/FixedBlockScheduler.h"
+#include "../../Shared/FractionalDelay.h"
+#include "../../Shared/PluginState.h"
+#include "../../Shared/PresetBank.h"
+#include "../../Shared/ProcessorOptions.h"
+#include "../../Shared/QualityGovernor.h"
+#include "../../Shared/ReadHead.h"
 
 #define MAX_DELAY_TIME 2
+#define MAX_CHANNELS 8
+
+// samples between LFO evaluations, linearly interpolated in between (16 or 32)
+#define CONTROL_INTERVAL 16
+#define COARSE_CONTROL_INTERVAL (4 * CONTROL_INTERVAL)
+
+// points in the shared sine LFO table (a power of two); linear interpolation
+// between them is within 1.2e-6 of std::sin
+#define LFO_TABLE_SIZE 2048
 //==============================================================================
 /**
 */
-class CoflangerAudioProcessor  : public juce::AudioProcessor
+class CoflangerAudioProcessor  : public juce::AudioProcessor,
+                                 public ProcessorOptions
 {
 public:
     //==============================================================================
@@ -30,6 +55,11 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    void processBlockBypassed (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlockBypassed (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -54,11 +84,62 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
-    float lin_interp(float sample_x, float sample_x1, float inPhase);
+    //==============================================================================
+    Analyzer& getAnalyzer();
+
+    //==============================================================================
+    // ProcessorOptions, each taking effect at the next prepareToPlay
+    void setFixedBlockSize(int blockSize) override;
+    void setParallelChannels(bool shouldProcessInParallel) override;
 
 private:
+    // tags this plugin's state blobs (see PluginState)
+    static constexpr juce::uint32 stateID = PluginState::hash ("Coflanger");
+
+    // what QualityGovernor steps down through under load
+    enum QualityLevel
+    {
+        fullQuality,
+        coarseModulation,   // LFO evaluated every COARSE_CONTROL_INTERVAL samples
+        nearestSampleRead,  // also no interpolation between delay line samples
+        maxQualityLevel = nearestSampleRead
+    };
+
+    // the parameters mAutomation spreads over each block
+    enum AutomationLane
+    {
+        dryWetLane,
+        depthLane,
+        rateLane,
+        phaseOffsetLane,
+        feedbackLane,
+        numAutomationLanes
+    };
+
+    // the DSP, for whichever sample type the host processes in. The delay
+    // lines store floats either way
+    template <typename FloatType>
+    void process (juce::AudioBuffer<FloatType>& buffer, juce::MidiBuffer& midiMessages, bool bypassed);
+    template <typename FloatType>
+    void processEffect (juce::AudioBuffer<FloatType>& buffer, juce::MidiBuffer& midiMessages);
+    template <typename FloatType>
+    void keepDelayLinesFed (juce::AudioBuffer<FloatType>& buffer);
+
+    template <typename FloatType>
+    void processChannel (int channel, FloatType* channelData, FloatType* wet, const ReadHead::Position* readPositions, int numSamples,
+                         FloatType feedback, FloatType dryWet, FractionalDelay::Interpolation interpolation,
+                         const QualityGovernor::Ramp& quality);
+    float readDelayLine (const float* circularBuffer, ReadHead::Position readHead, int qualityLevel,
+                         FractionalDelay::Interpolation interpolation, float& allpassState);
+    float getLfoDelayTime (float phase, float depth, int type, float sampleRate);
+
     float mLFOPhaseL,mLFOPhaseR;
 
+    // the LEFT/RIGHT read heads, gliding between LFO delay times
+    ReadHeadRamp<2> mReadHeads;
+
+    AutomationRamp<numAutomationLanes> mAutomation;
+
     juce::AudioParameterFloat* mDryWetParameter;
     juce::AudioParameterFloat* mDepthParameter;
     juce::AudioParameterFloat* mRateParameter;
@@ -66,18 +147,60 @@ private:
     juce::AudioParameterFloat* mFeedbackParameter;
     
     juce::AudioParameterInt* mTypeParameter;
+    QualityLevelParameter* mQualityParameter;
+    juce::AudioParameterChoice* mInterpolationParameter;
 
 
-    float mFeedbackLeft;
-    float mFeedbackRight;
+    float mFeedback[MAX_CHANNELS];
+    float mAllpassState[MAX_CHANNELS];
 
 
 
     int mCircularBufferWriteHead;
     int mCircularBufferLength;
 
-    float* mCircularBufferLeft;
-    float* mCircularBufferRight;
+    float* getDelayLine (int channel);
+
+    // one ring per channel, with FractionalDelay's guard samples around it.
+    // Leased from the shared pool while prepared (declared first, so it
+    // outlives the lease)
+    juce::SharedResourcePointer<DelayMemoryPool> mDelayMemoryPool;
+    DelayMemoryPool::Lease mDelayMemory;
+    int mDelayLineStride;
+    int mNumDelayLines;
+
+    // the LFO wavetable and interpolation weights, built once and shared
+    // with every other instance
+    juce::SharedResourcePointer<DspTables> mDspTables;
+    const DspTables::Table& mLfoTable { mDspTables->get(DspTables::Shape::sine, LFO_TABLE_SIZE) };
+    FractionalDelay::Tables mInterpolationTables { *mDspTables };
+
+    // where each sample of a chunk reads the delay lines, LEFT then RIGHT
+    std::vector<ReadHead::Position> mReadPositions;
+
+    // one wet channel per input channel, allocated for the host's precision only
+    std::tuple<juce::AudioBuffer<float>, juce::AudioBuffer<double>> mWetBuffers;
+
+    AutomationCapture mCapture;
+
+    const CpuDispatch::Kernels* mKernels;
+
+    std::unique_ptr<ChannelThreadPool> mChannelPool;
+    bool mParallelChannels { ChannelThreadPool::isRequestedByEnvironment() };
+
+    QualityGovernor mGovernor;
+    std::unique_ptr<QualityLevelPublisher> mQualityPublisher;
+
+    // the programs, morphed between on the audio thread
+    std::unique_ptr<PresetBank> mPresets;
+
+    BypassCrossfade mBypass;
+
+    // off unless JUCE_PROJECTS_FIXED_BLOCK_SIZE is set
+    FixedBlockScheduler mFixedBlocks;
+
+    // meters and spectrum for the editor, idle while it is closed
+    Analyzer mAnalyzer;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CoflangerAudioProcessor)
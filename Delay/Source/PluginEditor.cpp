@@ -11,8 +11,10 @@
 
 //==============================================================================
 DelayKadenzeAudioProcessorEditor::DelayKadenzeAudioProcessorEditor (DelayKadenzeAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p), mAnalyzerView (p.getAnalyzer())
 {
+    setOpaque(true);
+
     auto& params = processor.getParameters();
 
     juce::AudioParameterFloat* dryWetParameter = (juce::AudioParameterFloat*)params.getUnchecked(0);
@@ -26,6 +28,7 @@ DelayKadenzeAudioProcessorEditor::DelayKadenzeAudioProcessorEditor (DelayKadenze
     mDryWetSlider.onValueChange = [this, dryWetParameter] {*dryWetParameter = mDryWetSlider.getValue(); };
     mDryWetSlider.onDragStart = [dryWetParameter] {dryWetParameter->beginChangeGesture(); };
     mDryWetSlider.onDragEnd = [dryWetParameter] {dryWetParameter->endChangeGesture(); };
+    mParameterSync.bind(mDryWetSlider, *dryWetParameter);
 
     juce::AudioParameterFloat* feedbackParameter = (juce::AudioParameterFloat*)params.getUnchecked(1);
 
@@ -38,6 +41,7 @@ DelayKadenzeAudioProcessorEditor::DelayKadenzeAudioProcessorEditor (DelayKadenze
     mFeedbackSlider.onValueChange = [this, feedbackParameter] {*feedbackParameter = mFeedbackSlider.getValue(); };
     mFeedbackSlider.onDragStart = [feedbackParameter] {feedbackParameter->beginChangeGesture(); };
     mFeedbackSlider.onDragEnd = [feedbackParameter] {feedbackParameter->endChangeGesture(); };
+    mParameterSync.bind(mFeedbackSlider, *feedbackParameter);
 
     juce::AudioParameterFloat* DelayTimeParameter = (juce::AudioParameterFloat*)params.getUnchecked(2);
 
@@ -50,8 +54,14 @@ DelayKadenzeAudioProcessorEditor::DelayKadenzeAudioProcessorEditor (DelayKadenze
     mDelayTimeSlider.onValueChange = [this, DelayTimeParameter] {*DelayTimeParameter = mDelayTimeSlider.getValue(); };
     mDelayTimeSlider.onDragStart = [DelayTimeParameter] {DelayTimeParameter->beginChangeGesture(); };
     mDelayTimeSlider.onDragEnd = [DelayTimeParameter] {DelayTimeParameter->endChangeGesture(); };
+    mParameterSync.bind(mDelayTimeSlider, *DelayTimeParameter);
+
+    addAndMakeVisible(mAnalyzerView);
+
+    mParameterSync.updateAll();
 
-    setSize (400, 300);
+    setSize (designWidth, designHeight);
+    EditorRendering::makeResizable(*this);
 }
 
 DelayKadenzeAudioProcessorEditor::~DelayKadenzeAudioProcessorEditor()
@@ -60,10 +70,17 @@ DelayKadenzeAudioProcessorEditor::~DelayKadenzeAudioProcessorEditor()
 
 //==============================================================================
 void DelayKadenzeAudioProcessorEditor::paint (juce::Graphics& g)
+{
+    mStaticLayer.draw(g, getLocalBounds(), [this] (juce::Graphics& layer) { paintStaticLayer(layer); });
+}
+
+void DelayKadenzeAudioProcessorEditor::paintStaticLayer (juce::Graphics& g)
 {
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
 
+    g.addTransform(EditorRendering::DesignScale(*this, designWidth).getTransform());
+
     g.setColour (juce::Colours::white);
     g.setFont (15.0f);
     //g.drawFittedText ("Hello World!", getLocalBounds(), juce::Justification::centred, 1);
@@ -75,10 +92,14 @@ void DelayKadenzeAudioProcessorEditor::paint (juce::Graphics& g)
 
 void DelayKadenzeAudioProcessorEditor::resized()
 {
-    mDryWetSlider.setBounds(0, 0, 100, 100);
-    mFeedbackSlider.setBounds(100, 0, 100, 100);
+    const EditorRendering::DesignScale scaled (*this, designWidth);
+
+    mDryWetSlider.setBounds(scaled(0, 0, 100, 100));
+    mFeedbackSlider.setBounds(scaled(100, 0, 100, 100));
+
+    mDelayTimeSlider.setBounds(scaled(200, 0, 100, 100));
 
-    mDelayTimeSlider.setBounds(200, 0, 100, 100);
+    mAnalyzerView.setBounds(scaled(0, 150, 400, 150));
 
     // This is generally where you'll want to lay out the positions of any
     // subcomponents in your editor..
@@ -10,6 +10,9 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "../../Shared/AnalyzerView.h"
+#include "../../Shared/EditorRendering.h"
+#include "../../Shared/ParameterSync.h"
 
 //==============================================================================
 /**
@@ -25,6 +28,12 @@ public:
     void resized() override;
 
 private:
+    // the layout's coordinates; the editor itself can be resized from half to twice this
+    static constexpr int designWidth = 400;
+    static constexpr int designHeight = 300;
+
+    void paintStaticLayer(juce::Graphics& g);
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     DelayKadenzeAudioProcessor& audioProcessor;
@@ -33,5 +42,13 @@ private:
     juce::Slider mFeedbackSlider;
     juce::Slider mDelayTimeSlider;
 
+    AnalyzerView mAnalyzerView;
+
+    // moves the controls when the parameters change elsewhere (declared after them, so it goes first)
+    ParameterSync mParameterSync { audioProcessor, *this };
+
+    // background and labels, re-rendered only when the size or display scale changes
+    EditorRendering::CachedLayer mStaticLayer;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayKadenzeAudioProcessorEditor)
 };
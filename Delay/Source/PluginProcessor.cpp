@@ -8,6 +8,14 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "../../Shared/RealtimeGuard.h"
+#include "../../Shared/TraceEvents.h"
+
+// tools that link several plugins into one binary (JUCE_PROJECTS_MULTI_PLUGIN_BUILD)
+// provide the allocator hooks and their own entry point once, themselves
+#if ! JUCE_PROJECTS_MULTI_PLUGIN_BUILD
+ #include "../../Shared/RealtimeGuardAllocators.h"
+#endif
 
 //==============================================================================
 DelayKadenzeAudioProcessor::DelayKadenzeAudioProcessor()
@@ -28,26 +36,47 @@ DelayKadenzeAudioProcessor::DelayKadenzeAudioProcessor()
 
     addParameter(mDelayTimeParameter = new juce::AudioParameterFloat("delaytime", "Delay Time", 0.01, MAX_DELAY_TIME, 0.5));
 
-    mCircularBufferLeft = nullptr;
-    mCircularBufferRight = nullptr;
+    addParameter(mQualityParameter = new QualityLevelParameter(maxQualityLevel));
+    mQualityPublisher = std::make_unique<QualityLevelPublisher>(mGovernor, *mQualityParameter);
+
+    // in FractionalDelay::Interpolation order
+    addParameter(mInterpolationParameter = new juce::AudioParameterChoice("interpolation", "Interpolation",
+                                                                          { "Linear", "Hermite", "Allpass", "Sinc 8", "Sinc 16" }, 0));
+
+    // above MAX_DELAY_TIME this replaces Delay Time, up to minutes
+    addParameter(mLongDelayParameter = new juce::AudioParameterFloat("longdelay", "Long Delay", 0.0f, MAX_LONG_DELAY_TIME, 0.0f));
+
+    // stops taking input and keeps repeating what is in the delay line
+    addParameter(mFreezeParameter = new juce::AudioParameterBool("freeze", "Freeze", false));
+
+    mPresets = std::make_unique<PresetBank>(*this, 5);
+    mPresets->setPreset(1, "Slapback", { { "drywet", 0.35f }, { "feedback", 0.15f }, { "delaytime", 0.12f } });
+    mPresets->setPreset(2, "Quarter Echo", { { "drywet", 0.4f }, { "feedback", 0.45f }, { "delaytime", 0.5f } });
+    mPresets->setPreset(3, "Dub Throw", { { "drywet", 0.5f }, { "feedback", 0.8f }, { "delaytime", 0.75f }, { "interpolation", 1.0f } });
+    mPresets->setPreset(4, "Frozen Pad", { { "drywet", 0.7f }, { "delaytime", 1.5f }, { "interpolation", 3.0f }, { "freeze", 1.0f } });
+
+    mKernels = &CpuDispatch::getKernels();
+
     mCircularBufferWriteHead = 0;
     mCircularBufferLength = 0;
-    mDelayTimeInSamples = 0;
-    mDelayReadHead = 0;
-    mFeedbackLeft = 0.0;
-    mFeedbackRight = 0.0;
+    mDelayLineStride = 0;
+    mNumDelayLines = 0;
     mDelayTimeSmoothed = 0.0;
+
+    mRequestedDelayLineStorage = juce::SystemStats::getEnvironmentVariable("JUCE_PROJECTS_COMPACT_DELAY_LINES", {}).getIntValue() != 0
+                                     ? DelayLineStorage::compactInt16
+                                     : DelayLineStorage::float32;
+    mDelayLineStorage = mRequestedDelayLineStorage;
+
+    for (auto& channelFeedback : mFeedback)
+        channelFeedback = 0.0f;
+
+    for (auto& state : mAllpassState)
+        state = 0.0f;
 }
 
 DelayKadenzeAudioProcessor::~DelayKadenzeAudioProcessor()
 {
-    if (mCircularBufferLeft != nullptr) {
-        delete[] mCircularBufferLeft;
-    }
-
-    if (mCircularBufferRight != nullptr) {
-        delete[] mCircularBufferRight;
-    }
 }
 
 //==============================================================================
@@ -85,81 +114,131 @@ bool DelayKadenzeAudioProcessor::isMidiEffect() const
 
 double DelayKadenzeAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // frozen, the loop never decays
+    if (mFreezeParameter->get())
+        return std::numeric_limits<double>::infinity();
+
+    // the delay in effect, once per repeat until the feedback has taken the
+    // echoes 60 dB down
+    const double longDelayTime = mLongDelayParameter->get();
+    const double delayTime = longDelayTime > MAX_DELAY_TIME ? longDelayTime : (double) mDelayTimeParameter->get();
+    const double feedback = mFeedbackParameter->get();
+    const double numRepeats = feedback > 0.0 ? 1.0 + std::log(0.001) / std::log(feedback) : 1.0;
+
+    return delayTime * numRepeats;
 }
 
 int DelayKadenzeAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return mPresets->getNumPresets();
 }
 
 int DelayKadenzeAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return mPresets->getCurrentPreset();
 }
 
 void DelayKadenzeAudioProcessor::setCurrentProgram (int index)
 {
+    // morphs there from the audio thread, no parameter is touched until it arrives
+    mPresets->select(index);
 }
 
 const juce::String DelayKadenzeAudioProcessor::getProgramName (int index)
 {
-    return {};
+    return mPresets->getName(index);
 }
 
 void DelayKadenzeAudioProcessor::changeProgramName (int index, const juce::String& newName)
 {
+    mPresets->setName(index, newName);
 }
 
 //==============================================================================
 void DelayKadenzeAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    mDelayTimeInSamples = *mDelayTimeParameter * sampleRate;
+    TRACE_SCOPE ("Delay::prepareToPlay");
 
-    if (mCircularBufferLeft != nullptr) {
-        delete[] mCircularBufferLeft;
-        mCircularBufferLeft = new float[sampleRate * MAX_DELAY_TIME];
-        for (int i = 0; i < sampleRate * MAX_DELAY_TIME; i++)
-        {
-            mCircularBufferLeft[i] = 0.0;
-        }
-    }
+    // in fixed block mode the DSP only ever sees blocks of that size, a block late
+    samplesPerBlock = mFixedBlocks.prepare(juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()), samplesPerBlock);
+    setLatencySamples(mFixedBlocks.getLatencySamples());
 
-    if (mCircularBufferLeft == nullptr) {
-        mCircularBufferLeft = new float[sampleRate * MAX_DELAY_TIME];
-        for (int i = 0; i < sampleRate * MAX_DELAY_TIME; i++)
-        {
-            mCircularBufferLeft[i] = 0.0;
-        }
-    }
+    mPresets->prepare(sampleRate);
+    mAnalyzer.prepare(sampleRate);
+    mBypass.prepare(sampleRate, juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()));
 
-    if (mCircularBufferRight != nullptr) {
-        delete[] mCircularBufferRight;
-        mCircularBufferRight = new float[sampleRate * MAX_DELAY_TIME];
-        for (int i = 0; i < sampleRate * MAX_DELAY_TIME; i++)
-        {
-            mCircularBufferRight[i] = 0.0;
-        }
-    }
+    mCapture.startFromEnvironment (*this, sampleRate, samplesPerBlock);
+
+    const int numChannels = juce::jmin(getTotalNumInputChannels(), MAX_CHANNELS);
 
-    if (mCircularBufferRight == nullptr) {
-        mCircularBufferRight = new float[sampleRate * MAX_DELAY_TIME];
-        for (int i = 0; i < sampleRate * MAX_DELAY_TIME; i++)
-        {
-            mCircularBufferRight[i] = 0.0;
-        }
-    }
     mCircularBufferLength = MAX_DELAY_TIME * sampleRate;
     mCircularBufferWriteHead = 0;
+    mNumDelayLines = numChannels;
+    mDelayLineStorage = mRequestedDelayLineStorage;
+
+    const int storageSize = FractionalDelay::getStorageSize(mCircularBufferLength);
+    size_t sampleSize;
+
+    if (mDelayLineStorage == DelayLineStorage::compactInt16) {
+        mDelayLineStride = DelayMemoryPool::getAlignedStride<int16_t>(storageSize);
+        sampleSize = sizeof(int16_t);
+    }
+    else {
+        mDelayLineStride = DelayMemoryPool::getAlignedStride<float>(storageSize);
+        sampleSize = sizeof(float);
+    }
+
+    // given back first, so a re-prepare can get the same block again
+    mDelayMemory.reset();
+    mDelayMemory = mDelayMemoryPool->lease((size_t) numChannels * (size_t) mDelayLineStride * sampleSize);
 
-    mDelayTimeSmoothed = *mDelayTimeParameter;
+    // over the pool's budget: no delay lines, audio passes through untouched
+    if (! mDelayMemory.isValid()) {
+        mCircularBufferLength = 0;
+        mNumDelayLines = 0;
+    }
+
+    for (auto& channelFeedback : mFeedback)
+        channelFeedback = 0.0f;
+
+    for (auto& state : mAllpassState)
+        state = 0.0f;
+
+    mDelayTimeSmoothed = (double) mDelayTimeParameter->get();
+
+    const double initialDelayTime = mDelayTimeSmoothed * sampleRate;
+    mReadHead.reset(mCircularBufferLength, mCircularBufferWriteHead, CONTROL_INTERVAL, &initialDelayTime);
+
+    const float initialAutomation[numAutomationLanes] = { *mDryWetParameter, *mFeedbackParameter };
+    mAutomation.reset(initialAutomation);
+
+    // what was written to each delay line (for mHistory)
+    mScratchBuffer.setSize(numChannels, samplesPerBlock);
+    mReadPositions.resize((size_t) samplesPerBlock);
+
+    std::get<juce::AudioBuffer<float>>(mWetBuffers).setSize(numChannels, isUsingDoublePrecision() ? 0 : samplesPerBlock);
+    std::get<juce::AudioBuffer<double>>(mWetBuffers).setSize(numChannels, isUsingDoublePrecision() ? samplesPerBlock : 0);
+
+    mHistory.prepare(numChannels, sampleRate, MAX_LONG_DELAY_TIME + 1, samplesPerBlock);
+
+    // only used by offline renders, so realtime playback never waits on it
+    mChannelPool = mParallelChannels ? ChannelThreadPool::createForChannels(numChannels) : nullptr;
+
+    mGovernor.prepare(sampleRate, maxQualityLevel);
 }
 
 void DelayKadenzeAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    mCapture.stop();
+    mChannelPool.reset();
+    mHistory.release();
+
+    // back to the shared pool until the next prepareToPlay
+    mDelayMemory.reset();
+    mCircularBufferLength = 0;
+    mNumDelayLines = 0;
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -169,12 +248,10 @@ bool DelayKadenzeAudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Every channel is delayed on its own, so any layout up to MAX_CHANNELS
+    // works, including the wide stems of offline bounces.
+    if (layouts.getMainOutputChannelSet().isDisabled()
+     || layouts.getMainOutputChannelSet().size() > MAX_CHANNELS)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -190,7 +267,56 @@ bool DelayKadenzeAudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
 
 void DelayKadenzeAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    process(buffer, midiMessages, false);
+}
+
+void DelayKadenzeAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(buffer, midiMessages, false);
+}
+
+void DelayKadenzeAudioProcessor::processBlockBypassed (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(buffer, midiMessages, true);
+}
+
+void DelayKadenzeAudioProcessor::processBlockBypassed (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(buffer, midiMessages, true);
+}
+
+bool DelayKadenzeAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
+template <typename FloatType>
+void DelayKadenzeAudioProcessor::process (juce::AudioBuffer<FloatType>& buffer, juce::MidiBuffer& midiMessages, bool bypassed)
+{
+    // everything from here on runs on the audio thread, the bypass fade and
+    // the keep-alive path included
+    RealtimeGuard::ScopedAudioThread realtimeGuard;
     juce::ScopedNoDenormals noDenormals;
+
+    // once per host block, bypassed ones included, before fixed blocks or the
+    // bypass fade cut it up: a replay then makes the same calls
+    mCapture.captureBlock (buffer, getParameters(), bypassed);
+
+    mAnalyzer.pushInput(buffer);
+
+    mFixedBlocks.process(buffer, [&] (juce::AudioBuffer<FloatType>& block) {
+        mBypass.process(block, bypassed, [&] (juce::AudioBuffer<FloatType>& part) { processEffect(part, midiMessages); },
+                                         [&] (juce::AudioBuffer<FloatType>& part) { keepDelayLinesFed(part); });
+    });
+
+    mAnalyzer.pushOutput(buffer);
+}
+
+template <typename FloatType>
+void DelayKadenzeAudioProcessor::processEffect (juce::AudioBuffer<FloatType>& buffer, juce::MidiBuffer& midiMessages)
+{
+    QualityGovernor::ScopedBlockTimer qualityTimer (mGovernor, buffer.getNumSamples());
+    TRACE_SCOPE ("Delay::processBlock");
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -203,47 +329,229 @@ void DelayKadenzeAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    
+    if (mCircularBufferLength == 0)
+        return;
+
+    float dryWet, feedback, delayTime, longDelayTime;
+    bool freeze;
+    FractionalDelay::Interpolation interpolation;
+
+    {
+        TRACE_SCOPE ("parameter snapshot");
+        mPresets->beginBlock(buffer.getNumSamples());
+        dryWet = mPresets->read(*mDryWetParameter);
+        feedback = mPresets->read(*mFeedbackParameter);
+        delayTime = mPresets->read(*mDelayTimeParameter);
+        interpolation = (FractionalDelay::Interpolation) mPresets->read(*mInterpolationParameter);
+        longDelayTime = mPresets->read(*mLongDelayParameter);
+        freeze = mPresets->read(*mFreezeParameter);
+    }
+
+    const float automationTargets[numAutomationLanes] = { dryWet, feedback };
+    mAutomation.beginBlock(automationTargets, buffer.getNumSamples());
+
+    // frozen, the loop neither takes input nor decays
+    const FloatType inputGain = freeze ? FloatType (0) : FloatType (1);
+
+    // Long delays jump rather than glide: the read head can't sweep through
+    // minutes of disk-backed history.
+    const bool isLongDelay = longDelayTime > MAX_DELAY_TIME;
+
+    if (isLongDelay)
+        mHistory.startSpilling();
+
+    const juce::int64 longDelaySamples = juce::roundToInt((double) longDelayTime * getSampleRate());
+
+    const double sampleRate = getSampleRate();
+    const int numChannels = juce::jmin(totalNumInputChannels, mNumDelayLines);
+
+    // channels only share the read-only read positions, so offline renders can
+    // spread them over the pool
+    const bool processChannelsInParallel = isNonRealtime() && mChannelPool != nullptr;
+
+    mGovernor.setRealtime(! isNonRealtime());
+    mHistory.setRealtime(! isNonRealtime());
+
+    // the scratch buffers are sized in prepareToPlay, so longer host blocks are split up
+    auto& wetBuffer = std::get<juce::AudioBuffer<FloatType>>(mWetBuffers);
+    const int maxChunkSize = wetBuffer.getNumSamples();
+
+    if (maxChunkSize == 0)
+        return;
+
+    // ... and blocks in which dry/wet or feedback moved go in sub-blocks, each
+    // with its own step of mAutomation's ramp
+    int numSamples = 0;
 
-    float* leftChannel = buffer.getWritePointer(0);
-    float* rightChannel = buffer.getWritePointer(1);
+    for (int chunkStart = 0; chunkStart < buffer.getNumSamples(); chunkStart += numSamples)
+    {
+        numSamples = juce::jmin(maxChunkSize, mAutomation.getSubBlockLength(), buffer.getNumSamples() - chunkStart);
 
-    for (int i = 0; i < buffer.getNumSamples(); i++) {
-        mDelayTimeSmoothed = mDelayTimeSmoothed - 0.001 * (mDelayTimeSmoothed - *mDelayTimeParameter);
-        mDelayTimeInSamples = mDelayTimeSmoothed * getSampleRate();
+        const int chunkEnd = chunkStart + numSamples;
+        dryWet = mAutomation.getValue(dryWetLane, chunkEnd);
+        feedback = freeze ? 1.0f : mAutomation.getValue(feedbackLane, chunkEnd);
 
-        mCircularBufferLeft[mCircularBufferWriteHead] = leftChannel[i] + mFeedbackLeft;
-        mCircularBufferRight[mCircularBufferWriteHead] = rightChannel[i] + mFeedbackRight;
+        ReadHead::Position* readPositions = mReadPositions.data();
 
-        mDelayReadHead = mCircularBufferWriteHead - mDelayTimeInSamples;
+        {
+            TRACE_SCOPE ("delay time smoothing");
+
+            // the one-pole smoother jumps a whole control interval ahead at each
+            // control point (exact at those points), the read head glides in between
+            mReadHead.process(&readPositions, numSamples, [&] (int intervalLength, double* target) {
+                mDelayTimeSmoothed = (double) delayTime + (mDelayTimeSmoothed - (double) delayTime) * std::pow(1.0 - 0.001, (double) intervalLength);
+                target[0] = mDelayTimeSmoothed * sampleRate;
+            });
+        }
+
+        const auto quality = mGovernor.getNextRamp(numSamples);
+
+        // the long tap is whole samples behind the write head, so it needs no interpolation
+        const juce::int64 longDelayReadStart = mHistory.getNumSamplesPushed() - longDelaySamples;
+        const bool isLongDelayReadable = isLongDelay && longDelayReadStart >= 0
+                                      && mHistory.beginRead(longDelayReadStart, longDelayReadStart + numSamples);
+
+        auto processChannelChunk = [&] (int channel)
+        {
+            FloatType* channelData = buffer.getWritePointer(channel) + chunkStart;
+            FloatType* wet = wetBuffer.getWritePointer(channel);
+
+            if (isLongDelay) {
+                if (isLongDelayReadable) {
+                    for (int i = 0; i < numSamples; i++)
+                        wet[i] = (FloatType) mHistory.read(channel, longDelayReadStart + i, 0.0f);
+                }
+                else {
+                    juce::FloatVectorOperations::clear(wet, numSamples);
+                }
+            }
+
+            if (mDelayLineStorage == DelayLineStorage::compactInt16) {
+                processChannel(channel, FractionalDelay::getRingStart(getDelayLine<int16_t>(channel)), channelData, wet, readPositions,
+                               numSamples, inputGain, (FloatType) feedback, (FloatType) dryWet, interpolation, quality, isLongDelay);
+            }
+            else {
+                processChannel(channel, FractionalDelay::getRingStart(getDelayLine<float>(channel)), channelData, wet, readPositions,
+                               numSamples, inputGain, (FloatType) feedback, (FloatType) dryWet, interpolation, quality, isLongDelay);
+            }
+        };
+
+        if (processChannelsInParallel) {
+            mChannelPool->forEach(numChannels, processChannelChunk);
+        }
+        else {
+            for (int channel = 0; channel < numChannels; channel++)
+                processChannelChunk(channel);
+        }
 
-        if (mDelayReadHead < 0) {
-            mDelayReadHead += mCircularBufferLength;
+        const float* written[MAX_CHANNELS];
+
+        for (int channel = 0; channel < numChannels; channel++)
+            written[channel] = mScratchBuffer.getReadPointer(channel);
+
+        mHistory.push(written, numSamples);
+
+        mCircularBufferWriteHead = (mCircularBufferWriteHead + numSamples) % mCircularBufferLength;
+    }
+}
+
+template <typename FloatType>
+void DelayKadenzeAudioProcessor::keepDelayLinesFed (juce::AudioBuffer<FloatType>& buffer)
+{
+    TRACE_SCOPE ("Delay::keepDelayLinesFed");
+
+    if (mCircularBufferLength == 0)
+        return;
+
+    // bypassed, the delay lines take the dry input as it is: no feedback, nothing read
+    const int numChannels = juce::jmin(getTotalNumInputChannels(), mNumDelayLines);
+    const int maxChunkSize = mScratchBuffer.getNumSamples();
+
+    for (int chunkStart = 0; chunkStart < buffer.getNumSamples(); chunkStart += maxChunkSize)
+    {
+        const int numSamples = juce::jmin(maxChunkSize, buffer.getNumSamples() - chunkStart);
+        const float* written[MAX_CHANNELS];
+
+        for (int channel = 0; channel < numChannels; channel++) {
+            if constexpr (std::is_same<FloatType, float>::value) {
+                written[channel] = buffer.getReadPointer(channel) + chunkStart;
+            }
+            else {
+                // the delay lines and mHistory take floats
+                const FloatType* input = buffer.getReadPointer(channel) + chunkStart;
+                float* converted = mScratchBuffer.getWritePointer(channel);
+
+                for (int i = 0; i < numSamples; i++)
+                    converted[i] = (float) input[i];
+
+                written[channel] = converted;
+            }
+
+            if (mDelayLineStorage == DelayLineStorage::compactInt16) {
+                FractionalDelay::writeBlock(FractionalDelay::getRingStart(getDelayLine<int16_t>(channel)), mCircularBufferLength,
+                                            mCircularBufferWriteHead, written[channel], numSamples);
+            }
+            else {
+                FractionalDelay::writeBlock(FractionalDelay::getRingStart(getDelayLine<float>(channel)), mCircularBufferLength,
+                                            mCircularBufferWriteHead, written[channel], numSamples);
+            }
+
+            mFeedback[channel] = 0.0f;
         }
 
-        //interpolation
-        int readHead_x = (int)mDelayReadHead;
-        int readHead_x1 = (readHead_x + 1) % mCircularBufferLength; //wrap around if not in interval
+        mHistory.push(written, numSamples);
+
+        mCircularBufferWriteHead = (mCircularBufferWriteHead + numSamples) % mCircularBufferLength;
+        mReadHead.skip(numSamples);
+    }
+}
+
+template <typename Sample, typename FloatType>
+void DelayKadenzeAudioProcessor::processChannel (int channel, Sample* circularBuffer, FloatType* channelData, FloatType* wet,
+                                                  const ReadHead::Position* readPositions, int numSamples, FloatType inputGain,
+                                                  FloatType feedback, FloatType dryWet, FractionalDelay::Interpolation interpolation,
+                                                  const QualityGovernor::Ramp& quality, bool isWetPrefilled)
+{
+    float* written = mScratchBuffer.getWritePointer(channel);
+    FloatType channelFeedback = (FloatType) mFeedback[channel];
+    float allpassState = mAllpassState[channel];
+    int writeHead = mCircularBufferWriteHead;
 
-        float readHeadFloat = mDelayReadHead - readHead_x;
+    {
+        // writing and reading are fused: with feedback, each written sample
+        // depends on the previous read
+        TRACE_SCOPE ("delay write/read");
 
-        float delay_sample_left = lin_interp(mCircularBufferLeft[readHead_x], mCircularBufferLeft[readHead_x1], readHeadFloat);
-        float delay_sample_right = lin_interp(mCircularBufferRight[readHead_x], mCircularBufferRight[readHead_x1], readHeadFloat);
-        
-        mFeedbackLeft = delay_sample_left * *mFeedbackParameter;
-        mFeedbackRight = delay_sample_right * *mFeedbackParameter;
+        for (int i = 0; i < numSamples; i++) {
+            written[i] = (float) (channelData[i] * inputGain + channelFeedback);
+            FractionalDelay::write(circularBuffer, mCircularBufferLength, writeHead, written[i]);
 
+            // long delays were read from mHistory up front
+            if (! isWetPrefilled) {
+                wet[i] = (FloatType) readDelayLine(circularBuffer, readPositions[i], quality.level, interpolation, allpassState);
 
-        mCircularBufferWriteHead++;
+                if (quality.isCrossfading()) {
+                    FloatType gain = (FloatType) quality.getGain(i, numSamples);
+                    wet[i] = wet[i] * gain + (FloatType) readDelayLine(circularBuffer, readPositions[i], quality.previousLevel, interpolation, allpassState) * (FloatType (1) - gain);
+                }
+            }
+
+            channelFeedback = wet[i] * feedback;
+
+            writeHead++;
+
+            if (writeHead >= mCircularBufferLength)
+                writeHead = 0;
+        }
+    }
 
-        if (mCircularBufferWriteHead >= mCircularBufferLength)
-            mCircularBufferWriteHead = 0;
+    mFeedback[channel] = (float) channelFeedback;
+    mAllpassState[channel] = allpassState;
 
-        leftChannel[i] = leftChannel[i] * (1.0 - *mDryWetParameter) + delay_sample_left * *mDryWetParameter;
-        rightChannel[i] = rightChannel[i] * (1.0 - *mDryWetParameter) + delay_sample_right * *mDryWetParameter;
+    {
+        TRACE_SCOPE ("mix");
 
-        //buffer.setSample(0, i, buffer.getSample(0, i) * *mDryWetParameter + delay_sample_left * (1.0 - *mDryWetParameter));
-        //buffer.setSample(1, i, buffer.getSample(1, i) * *mDryWetParameter + delay_sample_right * (1.0 - *mDryWetParameter));
+        CpuDispatch::mix(*mKernels, channelData, wet, FloatType (1) - dryWet, dryWet, numSamples);
     }
 }
 
@@ -261,25 +569,67 @@ juce::AudioProcessorEditor* DelayKadenzeAudioProcessor::createEditor()
 //==============================================================================
 void DelayKadenzeAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    PluginState::write(*this, stateID, destData);
 }
 
 void DelayKadenzeAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    TRACE_SCOPE ("Delay::setStateInformation");
+
+    PluginState::read(*this, stateID, data, sizeInBytes);
+}
+
+//==============================================================================
+Analyzer& DelayKadenzeAudioProcessor::getAnalyzer()
+{
+    return mAnalyzer;
+}
+
+void DelayKadenzeAudioProcessor::setParallelChannels(bool shouldProcessInParallel)
+{
+    mParallelChannels = shouldProcessInParallel;
+}
+
+void DelayKadenzeAudioProcessor::setFixedBlockSize(int blockSize)
+{
+    mFixedBlocks.setBlockSize(blockSize);
+}
+
+template <typename Sample>
+Sample* DelayKadenzeAudioProcessor::getDelayLine (int channel)
+{
+    return mDelayMemory.getAs<Sample>() + channel * mDelayLineStride;
+}
+
+template <typename Sample>
+float DelayKadenzeAudioProcessor::readDelayLine (const Sample* circularBuffer, ReadHead::Position readHead, int qualityLevel,
+                                                 FractionalDelay::Interpolation interpolation, float& allpassState)
+{
+    // the read head stays in [0, length), so its integer part indexes the ring as it is
+    const int readHead_x = ReadHead::getIndex(readHead);
+
+    if (qualityLevel >= nearestSampleRead)
+        return FractionalDelay::decode(circularBuffer[readHead_x]);
+
+    // the guard samples around the ring stand in for the wrap around
+    return FractionalDelay::read(mInterpolationTables, interpolation, circularBuffer, readHead_x, ReadHead::getFraction(readHead), allpassState);
+}
+
+void DelayKadenzeAudioProcessor::setDelayLineStorage(DelayLineStorage storage)
+{
+    mRequestedDelayLineStorage = storage;
 }
 
-float DelayKadenzeAudioProcessor::lin_interp(float sample_x, float sample_x1, float inPhase)
+DelayKadenzeAudioProcessor::DelayLineStorage DelayKadenzeAudioProcessor::getDelayLineStorage() const
 {
-    return (1.0 - inPhase) * sample_x + inPhase * sample_x1;
+    return mRequestedDelayLineStorage;
 }
 
 //==============================================================================
+#if ! JUCE_PROJECTS_MULTI_PLUGIN_BUILD
 // This creates new instances of the plugin..
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 {
     return new DelayKadenzeAudioProcessor();
 }
+#endif
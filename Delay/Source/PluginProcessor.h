@@ -9,13 +9,36 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "../../Shared/Analyzer.h"
+#include "../../Shared/AutomationCapture.h"
+#include "../../Shared/AutomationRamp.h"
+#include "../../Shared/BypassCrossfade.h"
+#include "../../Shared/ChannelThreadPool.h"
+#include "../../Shared/CpuDispatch.h"
+#include "../../Shared/DelayMemoryPool.h"
+#include "../../Shared/DspTables.h"
+#include "../../Shared/FixedBlockScheduler.h"
+#include "../../Shared/FractionalDelay.h"
+#include "../../Shared/PluginState.h"
+#include "../../Shared/PresetBank.h"
+#include "../../Shared/ProcessorOptions.h"
+#include "../../Shared/QualityGovernor.h"
+#include "../../Shared/ReadHead.h"
+#include "../../Shared/SpillingHistory.h"
 
 #define MAX_DELAY_TIME 2
+// long delays are read back from SpillingHistory, mostly from disk
+#define MAX_LONG_DELAY_TIME 300
+#define MAX_CHANNELS 8
+
+// samples between delay time smoother steps, linearly interpolated in between (16 or 32)
+#define CONTROL_INTERVAL 16
 
 //==============================================================================
 /**
 */
-class DelayKadenzeAudioProcessor  : public juce::AudioProcessor
+class DelayKadenzeAudioProcessor  : public juce::AudioProcessor,
+                                    public ProcessorOptions
 {
 public:
     //==============================================================================
@@ -31,6 +54,11 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    void processBlockBypassed (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlockBypassed (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -55,26 +83,135 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
-    float lin_interp(float sample_x, float sample_x1, float inPhase);
+    //==============================================================================
+    Analyzer& getAnalyzer();
+
+    //==============================================================================
+    // ProcessorOptions, each taking effect at the next prepareToPlay
+    void setFixedBlockSize(int blockSize) override;
+    void setParallelChannels(bool shouldProcessInParallel) override;
+
+    //==============================================================================
+    // how the delay lines keep their samples; compact halves their memory
+    // (see FractionalDelay::SampleStorage<int16_t> for the noise it adds)
+    enum class DelayLineStorage
+    {
+        float32,
+        compactInt16
+    };
+
+    // takes effect at the next prepareToPlay. Defaults to compactInt16 when
+    // the JUCE_PROJECTS_COMPACT_DELAY_LINES environment variable is 1
+    void setDelayLineStorage(DelayLineStorage storage);
+    DelayLineStorage getDelayLineStorage() const;
 
 private:
+    // tags this plugin's state blobs (see PluginState)
+    static constexpr juce::uint32 stateID = PluginState::hash ("Delay");
+
+    // what QualityGovernor steps down through under load
+    enum QualityLevel
+    {
+        fullQuality,
+        nearestSampleRead,  // no interpolation between delay line samples
+        maxQualityLevel = nearestSampleRead
+    };
+
+    // the parameters mAutomation spreads over each block
+    enum AutomationLane
+    {
+        dryWetLane,
+        feedbackLane,
+        numAutomationLanes
+    };
+
+    // the DSP, for whichever sample type the host processes in. The delay
+    // lines and mHistory store floats (or int16s) either way
+    template <typename FloatType>
+    void process (juce::AudioBuffer<FloatType>& buffer, juce::MidiBuffer& midiMessages, bool bypassed);
+    template <typename FloatType>
+    void processEffect (juce::AudioBuffer<FloatType>& buffer, juce::MidiBuffer& midiMessages);
+    template <typename FloatType>
+    void keepDelayLinesFed (juce::AudioBuffer<FloatType>& buffer);
+
+    template <typename Sample, typename FloatType>
+    void processChannel (int channel, Sample* circularBuffer, FloatType* channelData, FloatType* wet, const ReadHead::Position* readPositions,
+                         int numSamples, FloatType inputGain, FloatType feedback, FloatType dryWet,
+                         FractionalDelay::Interpolation interpolation, const QualityGovernor::Ramp& quality, bool isWetPrefilled);
+    template <typename Sample>
+    float readDelayLine (const Sample* circularBuffer, ReadHead::Position readHead, int qualityLevel,
+                         FractionalDelay::Interpolation interpolation, float& allpassState);
+
     juce::AudioParameterFloat* mDryWetParameter;
     juce::AudioParameterFloat* mFeedbackParameter;
     juce::AudioParameterFloat* mDelayTimeParameter;
+    QualityLevelParameter* mQualityParameter;
+    juce::AudioParameterChoice* mInterpolationParameter;
+    juce::AudioParameterFloat* mLongDelayParameter;
+    juce::AudioParameterBool* mFreezeParameter;
+
+    template <typename Sample>
+    Sample* getDelayLine (int channel);
+
+    // one ring per channel, with FractionalDelay's guard samples around it,
+    // of floats or int16s depending on mDelayLineStorage. Leased from the
+    // shared pool while prepared (declared first, so it outlives the lease)
+    juce::SharedResourcePointer<DelayMemoryPool> mDelayMemoryPool;
+    DelayMemoryPool::Lease mDelayMemory;
+    int mDelayLineStride;
+    int mNumDelayLines;
+
+    DelayLineStorage mDelayLineStorage;
+    DelayLineStorage mRequestedDelayLineStorage;
+
+    // interpolation weights, built once and shared with every other instance
+    juce::SharedResourcePointer<DspTables> mDspTables;
+    FractionalDelay::Tables mInterpolationTables { *mDspTables };
 
-    float* mCircularBufferLeft;
-    float* mCircularBufferRight;
+    juce::AudioBuffer<float> mScratchBuffer;
+
+    // where each sample of a chunk reads the delay lines, shared by every channel
+    std::vector<ReadHead::Position> mReadPositions;
+
+    // one wet channel per input channel, allocated for the host's precision only
+    std::tuple<juce::AudioBuffer<float>, juce::AudioBuffer<double>> mWetBuffers;
+
+    AutomationCapture mCapture;
+
+    const CpuDispatch::Kernels* mKernels;
+
+    std::unique_ptr<ChannelThreadPool> mChannelPool;
+    bool mParallelChannels { ChannelThreadPool::isRequestedByEnvironment() };
+
+    QualityGovernor mGovernor;
+    std::unique_ptr<QualityLevelPublisher> mQualityPublisher;
+
+    // the programs, morphed between on the audio thread
+    std::unique_ptr<PresetBank> mPresets;
+
+    BypassCrossfade mBypass;
+
+    // off unless JUCE_PROJECTS_FIXED_BLOCK_SIZE is set
+    FixedBlockScheduler mFixedBlocks;
+
+    // meters and spectrum for the editor, idle while it is closed
+    Analyzer mAnalyzer;
 
     int mCircularBufferWriteHead;
     int mCircularBufferLength;
 
-    float mDelayTimeInSamples;
-    float mDelayReadHead;
+    float mFeedback[MAX_CHANNELS];
+    float mAllpassState[MAX_CHANNELS];
+
+    double mDelayTimeSmoothed;
+
+    // the read head, gliding between smoothed delay times
+    ReadHeadRamp<1> mReadHead;
 
-    float mFeedbackLeft;
-    float mFeedbackRight;
+    AutomationRamp<numAutomationLanes> mAutomation;
 
-    float mDelayTimeSmoothed;
+    // everything written to the delay lines, for delays beyond MAX_DELAY_TIME
+    SpillingHistory mHistory;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayKadenzeAudioProcessor)
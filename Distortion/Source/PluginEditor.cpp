@@ -11,8 +11,10 @@
 
 //==============================================================================
 DistortionAudioProcessorEditor::DistortionAudioProcessorEditor (DistortionAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p), _analyzerView (p.getAnalyzer())
 {
+    setOpaque (true);
+
     addAndMakeVisible(_driveKnob = new juce::Slider("Drive"));
     _driveKnob->setSliderStyle(juce::Slider::Rotary);
     _driveKnob->setTextBoxStyle(juce::Slider::NoTextBox, false, 100, 100);
@@ -34,29 +36,84 @@ DistortionAudioProcessorEditor::DistortionAudioProcessorEditor (DistortionAudioP
     _blendAttachment = new juce::AudioProcessorValueTreeState::SliderAttachment(p.getState(), "blend", *_blendKnob);
     _volumeAttachment = new juce::AudioProcessorValueTreeState::SliderAttachment(p.getState(), "volume", *_volumeKnob);
 
+    addAndMakeVisible(_bandsSlider = new juce::Slider("Bands"));
+    _bandsSlider->setSliderStyle(juce::Slider::LinearBar);
+    _bandsAttachment = new juce::AudioProcessorValueTreeState::SliderAttachment(p.getState(), "bands", *_bandsSlider);
+
+    for (int crossover = 1; crossover < LinkwitzRileyBands::maxBands; ++crossover)
+        _crossoverKnobs.add(addBandKnob("crossover" + juce::String(crossover)));
+
+    for (int band = 1; band <= LinkwitzRileyBands::maxBands; ++band)
+    {
+        _bandKnobs.add(addBandKnob("drive" + juce::String(band)));
+        _bandKnobs.add(addBandKnob("blend" + juce::String(band)));
+        _bandKnobs.add(addBandKnob("level" + juce::String(band)));
+    }
+
+    addAndMakeVisible(_analyzerView);
+
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (500, 200);
+    setSize (_designWidth, _designHeight);
+    EditorRendering::makeResizable (*this);
 }
 
 DistortionAudioProcessorEditor::~DistortionAudioProcessorEditor()
 {
 }
 
+juce::Slider* DistortionAudioProcessorEditor::addBandKnob (const juce::String& parameterID)
+{
+    auto* knob = new juce::Slider(parameterID);
+    knob->setSliderStyle(juce::Slider::Rotary);
+    knob->setTextBoxStyle(juce::Slider::NoTextBox, false, 100, 100);
+    addAndMakeVisible(knob);
+
+    _bandAttachments.add(new juce::AudioProcessorValueTreeState::SliderAttachment(audioProcessor.getState(), parameterID, *knob));
+    return knob;
+}
+
 //==============================================================================
 void DistortionAudioProcessorEditor::paint (juce::Graphics& g)
+{
+    _staticLayer.draw (g, getLocalBounds(), [this] (juce::Graphics& layer) { paintStaticLayer (layer); });
+}
+
+void DistortionAudioProcessorEditor::paintStaticLayer (juce::Graphics& g)
 {
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
 
+    g.addTransform (EditorRendering::DesignScale (*this, _designWidth).getTransform());
+
     g.setColour (juce::Colours::white);
     g.setFont (15.0f);
     //g.drawFittedText ("Hello World!", getLocalBounds(), juce::Justification::centred, 1);
 
-    g.drawText("Drive", getWidth() / 5 - 100 / 2, getHeight() / 2 + 5, 100, 100, juce::Justification::centred, false);
-    g.drawText("Range", getWidth() * 2 / 5 - 100 / 2, getHeight() / 2 + 5, 100, 100, juce::Justification::centred, false);
-    g.drawText("Blend", getWidth() * 3 / 5 - 100 / 2, getHeight() / 2 + 5, 100, 100, juce::Justification::centred, false);
-    g.drawText("Volume", getWidth() * 4 / 5 - 100 / 2, getHeight() / 2 + 5, 100, 100, juce::Justification::centred, false);
+    g.drawText("Drive", _designWidth / 5 - 100 / 2, _controlsHeight / 2 + 5, 100, 100, juce::Justification::centred, false);
+    g.drawText("Range", _designWidth * 2 / 5 - 100 / 2, _controlsHeight / 2 + 5, 100, 100, juce::Justification::centred, false);
+    g.drawText("Blend", _designWidth * 3 / 5 - 100 / 2, _controlsHeight / 2 + 5, 100, 100, juce::Justification::centred, false);
+    g.drawText("Volume", _designWidth * 4 / 5 - 100 / 2, _controlsHeight / 2 + 5, 100, 100, juce::Justification::centred, false);
+
+    // the bands section: band count, a column of knobs per band, and the
+    // crossovers on the column borders between the bands they split
+    g.drawText("Bands", 0, _controlsHeight, _bandColumnWidth, 20, juce::Justification::centred, false);
+
+    g.setFont (12.0f);
+
+    for (int band = 0; band < LinkwitzRileyBands::maxBands; ++band)
+    {
+        const int x = (band + 1) * _bandColumnWidth;
+
+        g.drawText("Band " + juce::String(band + 1), x, _controlsHeight, _bandColumnWidth, 20, juce::Justification::centred, false);
+        g.drawText("Drive", x, _controlsHeight + 20 + _bandKnobSize, _bandColumnWidth / 3, 15, juce::Justification::centred, false);
+        g.drawText("Blend", x + _bandColumnWidth / 3, _controlsHeight + 20 + _bandKnobSize, _bandColumnWidth / 3, 15, juce::Justification::centred, false);
+        g.drawText("Level", x + _bandColumnWidth * 2 / 3, _controlsHeight + 20 + _bandKnobSize, _bandColumnWidth / 3, 15, juce::Justification::centred, false);
+    }
+
+    for (int crossover = 1; crossover < LinkwitzRileyBands::maxBands; ++crossover)
+        g.drawText("Crossover " + juce::String(crossover), (crossover + 1) * _bandColumnWidth - _bandColumnWidth / 2, _controlsHeight + 90 + _crossoverKnobSize,
+                   _bandColumnWidth, 15, juce::Justification::centred, false);
 }
 
 void DistortionAudioProcessorEditor::resized()
@@ -64,8 +121,24 @@ void DistortionAudioProcessorEditor::resized()
     // This is generally where you'll want to lay out the positions of any
     // subcomponents in your editor..
 
-    _driveKnob->setBounds(getWidth() / 5 - 100 / 2, getHeight() / 2 - 100 / 2, 100, 100);
-    _rangeKnob->setBounds(getWidth() * 2 / 5 - 100 / 2, getHeight() / 2 - 100 / 2, 100, 100);
-    _blendKnob->setBounds(getWidth() * 3 / 5 - 100 / 2, getHeight() / 2 - 100 / 2, 100, 100);
-    _volumeKnob->setBounds(getWidth() * 4 / 5 - 100 / 2, getHeight() / 2 - 100 / 2, 100, 100);
+    const EditorRendering::DesignScale scaled (*this, _designWidth);
+
+    _driveKnob->setBounds(scaled(_designWidth / 5 - 100 / 2, _controlsHeight / 2 - 100 / 2, 100, 100));
+    _rangeKnob->setBounds(scaled(_designWidth * 2 / 5 - 100 / 2, _controlsHeight / 2 - 100 / 2, 100, 100));
+    _blendKnob->setBounds(scaled(_designWidth * 3 / 5 - 100 / 2, _controlsHeight / 2 - 100 / 2, 100, 100));
+    _volumeKnob->setBounds(scaled(_designWidth * 4 / 5 - 100 / 2, _controlsHeight / 2 - 100 / 2, 100, 100));
+
+    _bandsSlider->setBounds(scaled(10, _controlsHeight + 25, _bandColumnWidth - 20, 24));
+
+    for (int knob = 0; knob < _bandKnobs.size(); ++knob)
+    {
+        const int band = knob / 3;
+        const int x = (band + 1) * _bandColumnWidth + (knob % 3) * _bandColumnWidth / 3 + (_bandColumnWidth / 3 - _bandKnobSize) / 2;
+        _bandKnobs[knob]->setBounds(scaled(x, _controlsHeight + 20, _bandKnobSize, _bandKnobSize));
+    }
+
+    for (int crossover = 0; crossover < _crossoverKnobs.size(); ++crossover)
+        _crossoverKnobs[crossover]->setBounds(scaled((crossover + 2) * _bandColumnWidth - _crossoverKnobSize / 2, _controlsHeight + 90, _crossoverKnobSize, _crossoverKnobSize));
+
+    _analyzerView.setBounds(scaled(0, _controlsHeight + _bandsHeight, _designWidth, _designHeight - _controlsHeight - _bandsHeight));
 }
@@ -10,6 +10,8 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "../../Shared/AnalyzerView.h"
+#include "../../Shared/EditorRendering.h"
 
 //==============================================================================
 /**
@@ -25,6 +27,23 @@ public:
     void resized() override;
 
 private:
+    // the layout's coordinates; the editor itself can be resized from half to twice this.
+    // The knobs sit in a row _controlsHeight tall, the multiband controls in
+    // _bandsHeight below them, then the analyzer
+    static constexpr int _designWidth = 500;
+    static constexpr int _controlsHeight = 200;
+    static constexpr int _bandsHeight = 160;
+    static constexpr int _designHeight = _controlsHeight + _bandsHeight + 150;
+
+    // the bands section has a column per band, after one for the band count
+    static constexpr int _bandColumnWidth = _designWidth / (LinkwitzRileyBands::maxBands + 1);
+    static constexpr int _bandKnobSize = 30;
+    static constexpr int _crossoverKnobSize = 40;
+
+    void paintStaticLayer (juce::Graphics& g);
+
+    juce::Slider* addBandKnob (const juce::String& parameterID);
+
     juce::ScopedPointer<juce::Slider> _driveKnob;
     juce::ScopedPointer<juce::Slider> _rangeKnob;
     juce::ScopedPointer<juce::Slider> _blendKnob;
@@ -35,9 +54,22 @@ private:
     juce::ScopedPointer<juce::AudioProcessorValueTreeState::SliderAttachment> _blendAttachment;
     juce::ScopedPointer<juce::AudioProcessorValueTreeState::SliderAttachment> _volumeAttachment;
 
+    juce::ScopedPointer<juce::Slider> _bandsSlider;
+    juce::ScopedPointer<juce::AudioProcessorValueTreeState::SliderAttachment> _bandsAttachment;
+
+    // crossovers, lowest first, then each band's drive, blend and level
+    juce::OwnedArray<juce::Slider> _crossoverKnobs;
+    juce::OwnedArray<juce::Slider> _bandKnobs;
+    juce::OwnedArray<juce::AudioProcessorValueTreeState::SliderAttachment> _bandAttachments;
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     DistortionAudioProcessor& audioProcessor;
 
+    AnalyzerView _analyzerView;
+
+    // background and labels, re-rendered only when the size or display scale changes
+    EditorRendering::CachedLayer _staticLayer;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DistortionAudioProcessorEditor)
 };
@@ -8,6 +8,14 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "../../Shared/RealtimeGuard.h"
+#include "../../Shared/TraceEvents.h"
+
+// tools that link several plugins into one binary (JUCE_PROJECTS_MULTI_PLUGIN_BUILD)
+// provide the allocator hooks and their own entry point once, themselves
+#if ! JUCE_PROJECTS_MULTI_PLUGIN_BUILD
+ #include "../../Shared/RealtimeGuardAllocators.h"
+#endif
 
 //==============================================================================
 DistortionAudioProcessor::DistortionAudioProcessor()
@@ -22,6 +30,8 @@ DistortionAudioProcessor::DistortionAudioProcessor()
                        )
 #endif
 {
+    _kernels = &CpuDispatch::getKernels();
+
     _state = new juce::AudioProcessorValueTreeState(*this, nullptr);
 
     _state->createAndAddParameter("drive", "Drive", "Drive", juce::NormalisableRange<float>(0.0, 1.0, 0.0001), 0.4, nullptr, nullptr);
@@ -29,10 +39,52 @@ DistortionAudioProcessor::DistortionAudioProcessor()
     _state->createAndAddParameter("blend", "Blend", "Blend", juce::NormalisableRange<float>(0.0, 1.0, 0.0001), 0.5, nullptr, nullptr);
     _state->createAndAddParameter("volume", "Volume", "Volume", juce::NormalisableRange<float>(0.0, 3.0, 0.0001), 1.0, nullptr, nullptr);
 
-    _state->state = juce::ValueTree("drive");
-    _state->state = juce::ValueTree("range");
-    _state->state = juce::ValueTree("blend");
-    _state->state = juce::ValueTree("volume");
+    // parameter values are saved by PluginState, this tree only has to be valid
+    _state->state = juce::ValueTree ("Distortion");
+
+    addParameter (_qualityParameter = new QualityLevelParameter (maxQualityLevel));
+    _qualityPublisher = std::make_unique<QualityLevelPublisher> (_governor, *_qualityParameter);
+
+    // the multiband mode: one band is the full band shaper above, the band
+    // parameters scale its drive, blend and volume
+    _state->createAndAddParameter("bands", "Bands", "Bands", juce::NormalisableRange<float>(1.0, 4.0, 1.0), 1.0, nullptr, nullptr);
+    _state->createAndAddParameter("crossover1", "Crossover 1", "Crossover 1", juce::NormalisableRange<float>(20.0, 20000.0, 1.0, 0.25), 200.0, nullptr, nullptr);
+    _state->createAndAddParameter("crossover2", "Crossover 2", "Crossover 2", juce::NormalisableRange<float>(20.0, 20000.0, 1.0, 0.25), 1000.0, nullptr, nullptr);
+    _state->createAndAddParameter("crossover3", "Crossover 3", "Crossover 3", juce::NormalisableRange<float>(20.0, 20000.0, 1.0, 0.25), 5000.0, nullptr, nullptr);
+
+    for (int band = 1; band <= LinkwitzRileyBands::maxBands; ++band)
+    {
+        const juce::String number (band);
+
+        _state->createAndAddParameter("drive" + number, "Band " + number + " Drive", "Band " + number + " Drive", juce::NormalisableRange<float>(0.0, 2.0, 0.0001), 1.0, nullptr, nullptr);
+        _state->createAndAddParameter("blend" + number, "Band " + number + " Blend", "Band " + number + " Blend", juce::NormalisableRange<float>(0.0, 1.0, 0.0001), 1.0, nullptr, nullptr);
+        _state->createAndAddParameter("level" + number, "Band " + number + " Level", "Band " + number + " Level", juce::NormalisableRange<float>(0.0, 2.0, 0.0001), 1.0, nullptr, nullptr);
+    }
+
+    // looked up once here, getParameter does a string-keyed search
+    _automatedParameters[driveLane] = _state->getParameter ("drive");
+    _automatedParameters[rangeLane] = _state->getParameter ("range");
+    _automatedParameters[blendLane] = _state->getParameter ("blend");
+    _automatedParameters[volumeLane] = _state->getParameter ("volume");
+
+    for (int crossover = 0; crossover < LinkwitzRileyBands::maxBands - 1; ++crossover)
+        _automatedParameters[firstCrossoverLane + crossover] = _state->getParameter ("crossover" + juce::String (crossover + 1));
+
+    for (int band = 0; band < LinkwitzRileyBands::maxBands; ++band)
+    {
+        const juce::String number (band + 1);
+
+        _automatedParameters[firstBandDriveLane + band] = _state->getParameter ("drive" + number);
+        _automatedParameters[firstBandBlendLane + band] = _state->getParameter ("blend" + number);
+        _automatedParameters[firstBandLevelLane + band] = _state->getParameter ("level" + number);
+    }
+
+    _bandsParameter = _state->getParameter ("bands");
+
+    _presets = std::make_unique<PresetBank> (*this, 4);
+    _presets->setPreset (1, "Warm Drive", { { "drive", 0.3f }, { "range", 300.0f }, { "blend", 0.4f }, { "volume", 1.0f } });
+    _presets->setPreset (2, "Crunch", { { "drive", 0.6f }, { "range", 1200.0f }, { "blend", 0.7f }, { "volume", 0.7f } });
+    _presets->setPreset (3, "Fuzz", { { "drive", 0.9f }, { "range", 3000.0f }, { "blend", 1.0f }, { "volume", 0.4f } });
 }
 
 DistortionAudioProcessor::~DistortionAudioProcessor()
@@ -79,39 +131,75 @@ double DistortionAudioProcessor::getTailLengthSeconds() const
 
 int DistortionAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return _presets->getNumPresets();
 }
 
 int DistortionAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return _presets->getCurrentPreset();
 }
 
 void DistortionAudioProcessor::setCurrentProgram (int index)
 {
+    // morphs there from the audio thread, no parameter is touched until it arrives
+    _presets->select (index);
 }
 
 const juce::String DistortionAudioProcessor::getProgramName (int index)
 {
-    return {};
+    return _presets->getName (index);
 }
 
 void DistortionAudioProcessor::changeProgramName (int index, const juce::String& newName)
 {
+    _presets->setName (index, newName);
 }
 
 //==============================================================================
 void DistortionAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    // Use this method as the place to do any pre-playback
-    // initialisation that you need..
+    TRACE_SCOPE ("Distortion::prepareToPlay");
+
+    // in fixed block mode the DSP only ever sees blocks of that size, a block late
+    samplesPerBlock = _fixedBlocks.prepare (juce::jmax (getTotalNumInputChannels(), getTotalNumOutputChannels()), samplesPerBlock);
+    setLatencySamples (_fixedBlocks.getLatencySamples());
+
+    _presets->prepare (sampleRate);
+    _analyzer.prepare (sampleRate);
+    _bypass.prepare (sampleRate, juce::jmax (getTotalNumInputChannels(), getTotalNumOutputChannels()));
+
+    _capture.startFromEnvironment (*this, sampleRate, samplesPerBlock);
+
+    const int numChannels = juce::jmin (getTotalNumInputChannels(), MAX_CHANNELS);
+
+    // shaped (wet) signal, one channel per input channel, then the same
+    // shaped at the previous quality level while the governor crossfades
+    std::get<juce::AudioBuffer<float>> (_scratchBuffers).setSize (2 * numChannels, isUsingDoublePrecision() ? 0 : samplesPerBlock);
+    std::get<juce::AudioBuffer<double>> (_scratchBuffers).setSize (2 * numChannels, isUsingDoublePrecision() ? samplesPerBlock : 0);
+
+    // the bands of all channels are split and shaped together, in float
+    _bands.prepare (sampleRate, numChannels, samplesPerBlock);
+    _previousBands.setSize (1, samplesPerBlock * juce::jmax (1, numChannels) * LinkwitzRileyBands::maxBands);
+
+    // only used by offline renders, so realtime playback never waits on it
+    _channelPool = _parallelChannels ? ChannelThreadPool::createForChannels (numChannels) : nullptr;
+
+    float initialAutomation[numAutomationLanes];
+
+    for (int lane = 0; lane < numAutomationLanes; ++lane)
+        initialAutomation[lane] = _automatedParameters[lane]->convertFrom0to1 (_automatedParameters[lane]->getValue());
+
+    _automation.reset (initialAutomation);
+
+    _governor.prepare (sampleRate, maxQualityLevel);
 }
 
 void DistortionAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    _capture.stop();
+    _channelPool.reset();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -121,12 +209,10 @@ bool DistortionAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Every channel is shaped on its own, so any layout up to MAX_CHANNELS
+    // works, including the wide stems of offline bounces.
+    if (layouts.getMainOutputChannelSet().isDisabled()
+     || layouts.getMainOutputChannelSet().size() > MAX_CHANNELS)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -142,7 +228,57 @@ bool DistortionAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
 
 void DistortionAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    process (buffer, midiMessages, false);
+}
+
+void DistortionAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process (buffer, midiMessages, false);
+}
+
+void DistortionAudioProcessor::processBlockBypassed (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process (buffer, midiMessages, true);
+}
+
+void DistortionAudioProcessor::processBlockBypassed (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process (buffer, midiMessages, true);
+}
+
+bool DistortionAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
+template <typename FloatType>
+void DistortionAudioProcessor::process (juce::AudioBuffer<FloatType>& buffer, juce::MidiBuffer& midiMessages, bool bypassed)
+{
+    // everything from here on runs on the audio thread, the bypass fade and
+    // the keep-alive path included
+    RealtimeGuard::ScopedAudioThread realtimeGuard;
     juce::ScopedNoDenormals noDenormals;
+
+    // once per host block, bypassed ones included, before fixed blocks or the
+    // bypass fade cut it up: a replay then makes the same calls
+    _capture.captureBlock (buffer, getParameters(), bypassed);
+
+    _analyzer.pushInput (buffer);
+
+    // the shaper keeps no state, so once faded out bypass is a pure passthrough
+    _fixedBlocks.process (buffer, [&] (juce::AudioBuffer<FloatType>& block) {
+        _bypass.process (block, bypassed, [&] (juce::AudioBuffer<FloatType>& part) { processEffect (part, midiMessages); },
+                                          [] (juce::AudioBuffer<FloatType>&) {});
+    });
+
+    _analyzer.pushOutput (buffer);
+}
+
+template <typename FloatType>
+void DistortionAudioProcessor::processEffect (juce::AudioBuffer<FloatType>& buffer, juce::MidiBuffer& midiMessages)
+{
+    QualityGovernor::ScopedBlockTimer qualityTimer (_governor, buffer.getNumSamples());
+    TRACE_SCOPE ("Distortion::processBlock");
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -162,28 +298,192 @@ void DistortionAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, j
     // Alternatively, you can process the samples with the channels
     // interleaved by keeping the same state.
 
-    float drive = *_state->getRawParameterValue("drive");
-    float range = *_state->getRawParameterValue("range");
-    float blend = *_state->getRawParameterValue("blend");
-    float volume = *_state->getRawParameterValue("volume");
+    float automationTargets[numAutomationLanes];
+    int numBands;
+
+    {
+        TRACE_SCOPE ("parameter snapshot");
+        _presets->beginBlock (buffer.getNumSamples());
+
+        for (int lane = 0; lane < numAutomationLanes; ++lane)
+            automationTargets[lane] = _presets->read (*_automatedParameters[lane]);
+
+        numBands = juce::roundToInt (_presets->read (*_bandsParameter));
+    }
+
+    _automation.beginBlock (automationTargets, buffer.getNumSamples());
+
+    // the scratch buffer is sized in prepareToPlay, so longer host blocks are split up
+    auto& scratchBuffer = std::get<juce::AudioBuffer<FloatType>> (_scratchBuffers);
+    const int maxChunkSize = scratchBuffer.getNumSamples();
+
+    if (maxChunkSize == 0)
+        return;
 
-    for (int channel = 0; channel < totalNumInputChannels; ++channel)
+    const int numChannels = juce::jmin (totalNumInputChannels, scratchBuffer.getNumChannels() / 2);
+
+    _governor.setRealtime (! isNonRealtime());
+    const auto quality = _governor.getNextRamp (buffer.getNumSamples());
+
+    if (numBands > 1 && numChannels > 0)
+    {
+        processBands (buffer, numChannels, numBands, quality);
+        return;
+    }
+
+    auto processChannel = [&] (int channel)
     {
         auto* channelData = buffer.getWritePointer (channel);
+        auto* wet = scratchBuffer.getWritePointer (channel);
+        auto* previousWet = scratchBuffer.getWritePointer (numChannels + channel);
+
+        // blocks in which a parameter moved go in sub-blocks, each with its own
+        // step of _automation's ramp
+        int numSamples = 0;
+
+        for (int chunkStart = 0; chunkStart < buffer.getNumSamples(); chunkStart += numSamples)
+        {
+            numSamples = juce::jmin (maxChunkSize, _automation.getSubBlockLength(), buffer.getNumSamples() - chunkStart);
+            auto* dry = channelData + chunkStart;
+
+            const int chunkEnd = chunkStart + numSamples;
+            const float chunkBlend = _automation.getValue (blendLane, chunkEnd);
+            const float chunkVolume = _automation.getValue (volumeLane, chunkEnd);
+            const auto inputGain = (FloatType) (_automation.getValue (driveLane, chunkEnd) * _automation.getValue (rangeLane, chunkEnd));
+            const auto dryGain = (FloatType) ((1.0f - chunkBlend) / 2.0f * chunkVolume);
+            const auto wetGain = (FloatType) (chunkBlend / 2.0f * chunkVolume);
+
+            {
+                TRACE_SCOPE ("shaping");
+
+                shape (quality.level, wet, dry, inputGain, numSamples);
+
+                if (quality.isCrossfading())
+                {
+                    shape (quality.previousLevel, previousWet, dry, inputGain, numSamples);
+
+                    for (int i = 0; i < numSamples; ++i)
+                    {
+                        auto gain = (FloatType) quality.getGain (chunkStart + i, buffer.getNumSamples());
+                        wet[i] = wet[i] * gain + previousWet[i] * (FloatType (1) - gain);
+                    }
+                }
+            }
+
+            {
+                TRACE_SCOPE ("mix");
+
+                CpuDispatch::mix (*_kernels, dry, wet, dryGain, wetGain, numSamples);
+            }
+        }
+    };
+
+    // channels share no state, so offline renders can spread them over the pool
+    if (isNonRealtime() && _channelPool != nullptr)
+    {
+        _channelPool->forEach (numChannels, processChannel);
+    }
+    else
+    {
+        for (int channel = 0; channel < numChannels; ++channel)
+            processChannel (channel);
+    }
+}
 
-        for (int sample = 0; sample < buffer.getNumSamples(); sample++)
+template <typename FloatType>
+void DistortionAudioProcessor::processBands (juce::AudioBuffer<FloatType>& buffer, int numChannels, int numBands, const QualityGovernor::Ramp& quality)
+{
+    _bands.setNumBands (numBands);
+
+    const int numLanes = _bands.getNumLanes();
+    const int maxChunkSize = _bands.getMaxBlockSize();
+    auto* driven = _bands.getDrivenBands();
+    auto* previousDriven = _previousBands.getWritePointer (0);
+
+    FloatType* channels[LinkwitzRileyBands::maxChannels];
+
+    // every band filter of every channel advances in one kernel pass, and
+    // every band is shaped in another, so this goes a sub-block at a time
+    // rather than a channel at a time
+    int numSamples = 0;
+
+    for (int chunkStart = 0; chunkStart < buffer.getNumSamples(); chunkStart += numSamples)
+    {
+        numSamples = juce::jmin (maxChunkSize, _automation.getSubBlockLength(), buffer.getNumSamples() - chunkStart);
+
+        const int chunkEnd = chunkStart + numSamples;
+        const float inputGain = _automation.getValue (driveLane, chunkEnd) * _automation.getValue (rangeLane, chunkEnd);
+        const float chunkBlend = _automation.getValue (blendLane, chunkEnd);
+        const float chunkVolume = _automation.getValue (volumeLane, chunkEnd);
+
+        float crossovers[LinkwitzRileyBands::maxBands - 1];
+        float dryGains[LinkwitzRileyBands::maxBands];
+        float wetGains[LinkwitzRileyBands::maxBands];
+
+        for (int crossover = 0; crossover < numBands - 1; ++crossover)
+            crossovers[crossover] = _automation.getValue (firstCrossoverLane + crossover, chunkEnd);
+
+        for (int band = 0; band < numBands; ++band)
         {
-            float drySignal = *channelData;
-            *channelData *= drive * range;
+            const float bandBlend = chunkBlend * _automation.getValue (firstBandBlendLane + band, chunkEnd);
+            const float bandVolume = chunkVolume * _automation.getValue (firstBandLevelLane + band, chunkEnd);
+
+            _bands.setDrive (band, inputGain * _automation.getValue (firstBandDriveLane + band, chunkEnd));
+            dryGains[band] = (1.0f - bandBlend) / 2.0f * bandVolume;
+            wetGains[band] = bandBlend / 2.0f * bandVolume;
+        }
 
-            *channelData = (((2.0 / juce::MathConstants<float>::pi) * atan(*channelData) * blend) + (drySignal * (1.0 - blend)))/2 * volume;
+        _bands.setCrossovers (crossovers);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            channels[channel] = buffer.getWritePointer (channel) + chunkStart;
+
+        {
+            TRACE_SCOPE ("band split");
 
-            channelData++;
+            _bands.split (*_kernels, channels, numSamples);
+        }
+
+        {
+            TRACE_SCOPE ("shaping");
+
+            // the split already applied each band's drive
+            const int numValues = numSamples * numLanes;
+
+            if (quality.isCrossfading())
+                shape (quality.previousLevel, previousDriven, driven, 1.0f, numValues);
+
+            shape (quality.level, driven, driven, 1.0f, numValues);
+
+            if (quality.isCrossfading())
+            {
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    const auto gain = quality.getGain (chunkStart + i, buffer.getNumSamples());
+
+                    for (int lane = i * numLanes; lane < (i + 1) * numLanes; ++lane)
+                        driven[lane] = driven[lane] * gain + previousDriven[lane] * (1.0f - gain);
+                }
+            }
+        }
+
+        {
+            TRACE_SCOPE ("mix");
+
+            _bands.combine (channels, numSamples, dryGains, wetGains);
         }
-        
     }
 }
 
+template <typename FloatType>
+void DistortionAudioProcessor::shape (int qualityLevel, FloatType* dest, const FloatType* src, FloatType inputGain, int numSamples) const noexcept
+{
+    if (qualityLevel >= rationalShaper)
+        CpuDispatch::shapeRational (*_kernels, dest, src, inputGain, numSamples);
+    else
+        CpuDispatch::shapeAtan (*_kernels, dest, src, inputGain, numSamples);
+}
+
 //==============================================================================
 bool DistortionAudioProcessor::hasEditor() const
 {
@@ -198,23 +498,16 @@ juce::AudioProcessorEditor* DistortionAudioProcessor::createEditor()
 //==============================================================================
 void DistortionAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-
-    juce::MemoryOutputStream stream(destData, false);
-    _state->state.writeToStream(stream);
+    PluginState::write (*this, stateID, destData);
 }
 
 void DistortionAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
-    juce::ValueTree tree = juce::ValueTree::readFromData(data, sizeInBytes);
-    if (tree.isValid())
-    {
-        _state -> state = tree;
-    }
+    TRACE_SCOPE ("Distortion::setStateInformation");
+
+    // sessions saved before PluginState hold the value tree's own stream
+    if (! PluginState::read (*this, stateID, data, sizeInBytes))
+        PluginState::readLegacyValueTree (*this, data, sizeInBytes);
 }
 
 juce::AudioProcessorValueTreeState& DistortionAudioProcessor::getState()
@@ -222,9 +515,26 @@ juce::AudioProcessorValueTreeState& DistortionAudioProcessor::getState()
     return *_state;
 }
 
+Analyzer& DistortionAudioProcessor::getAnalyzer()
+{
+    return _analyzer;
+}
+
+void DistortionAudioProcessor::setParallelChannels (bool shouldProcessInParallel)
+{
+    _parallelChannels = shouldProcessInParallel;
+}
+
+void DistortionAudioProcessor::setFixedBlockSize (int blockSize)
+{
+    _fixedBlocks.setBlockSize (blockSize);
+}
+
 //==============================================================================
+#if ! JUCE_PROJECTS_MULTI_PLUGIN_BUILD
 // This creates new instances of the plugin..
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 {
     return new DistortionAudioProcessor();
 }
+#endif
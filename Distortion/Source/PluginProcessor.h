@@ -9,11 +9,26 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "../../Shared/Analyzer.h"
+#include "../../Shared/AutomationCapture.h"
+#include "../../Shared/AutomationRamp.h"
+#include "../../Shared/BypassCrossfade.h"
+#include "../../Shared/ChannelThreadPool.h"
+#include "../../Shared/CpuDispatch.h"
+#include "../../Shared/FixedBlockScheduler.h"
+#include "../../Shared/LinkwitzRiley.h"
+#include "../../Shared/PluginState.h"
+#include "../../Shared/PresetBank.h"
+#include "../../Shared/ProcessorOptions.h"
+#include "../../Shared/QualityGovernor.h"
+
+#define MAX_CHANNELS 8
 
 //==============================================================================
 /**
 */
-class DistortionAudioProcessor  : public juce::AudioProcessor
+class DistortionAudioProcessor  : public juce::AudioProcessor,
+                                  public ProcessorOptions
 {
 public:
     //==============================================================================
@@ -29,6 +44,11 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    void processBlockBypassed (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlockBypassed (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -54,10 +74,90 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
 
     juce::AudioProcessorValueTreeState& getState();
+    Analyzer& getAnalyzer();
+
+    //==============================================================================
+    // ProcessorOptions, each taking effect at the next prepareToPlay
+    void setFixedBlockSize (int blockSize) override;
+    void setParallelChannels (bool shouldProcessInParallel) override;
 
 private:
+    // tags this plugin's state blobs (see PluginState)
+    static constexpr juce::uint32 stateID = PluginState::hash ("Distortion");
+
+    // what QualityGovernor steps down through under load
+    enum QualityLevel
+    {
+        fullQuality,
+        rationalShaper,  // rational approximation of the atan curve, within 0.0033 of it
+        maxQualityLevel = rationalShaper
+    };
+
+    // the parameters _automation spreads over each block; the band lanes
+    // are LinkwitzRileyBands::maxBands long, the crossovers one less
+    enum AutomationLane
+    {
+        driveLane,
+        rangeLane,
+        blendLane,
+        volumeLane,
+        firstCrossoverLane,
+        firstBandDriveLane = firstCrossoverLane + LinkwitzRileyBands::maxBands - 1,
+        firstBandBlendLane = firstBandDriveLane + LinkwitzRileyBands::maxBands,
+        firstBandLevelLane = firstBandBlendLane + LinkwitzRileyBands::maxBands,
+        numAutomationLanes = firstBandLevelLane + LinkwitzRileyBands::maxBands
+    };
+
+    // the DSP, for whichever sample type the host processes in
+    template <typename FloatType>
+    void process (juce::AudioBuffer<FloatType>& buffer, juce::MidiBuffer& midiMessages, bool bypassed);
+
+    template <typename FloatType>
+    void processEffect (juce::AudioBuffer<FloatType>& buffer, juce::MidiBuffer& midiMessages);
+
+    template <typename FloatType>
+    void processBands (juce::AudioBuffer<FloatType>& buffer, int numChannels, int numBands, const QualityGovernor::Ramp& quality);
+
+    template <typename FloatType>
+    void shape (int qualityLevel, FloatType* dest, const FloatType* src, FloatType inputGain, int numSamples) const noexcept;
 
     juce::ScopedPointer<juce::AudioProcessorValueTreeState> _state;
+
+    // in AutomationLane order
+    juce::RangedAudioParameter* _automatedParameters[numAutomationLanes];
+    juce::RangedAudioParameter* _bandsParameter;
+    QualityLevelParameter* _qualityParameter;
+
+    // only the one for the host's precision is allocated
+    std::tuple<juce::AudioBuffer<float>, juce::AudioBuffer<double>> _scratchBuffers;
+
+    // the multiband mode: crossovers, and the driven bands shaped at the
+    // previous quality level while the governor crossfades
+    LinkwitzRileyBands _bands;
+    juce::AudioBuffer<float> _previousBands;
+
+    AutomationCapture _capture;
+
+    const CpuDispatch::Kernels* _kernels;
+
+    std::unique_ptr<ChannelThreadPool> _channelPool;
+    bool _parallelChannels { ChannelThreadPool::isRequestedByEnvironment() };
+
+    AutomationRamp<numAutomationLanes> _automation;
+
+    QualityGovernor _governor;
+    std::unique_ptr<QualityLevelPublisher> _qualityPublisher;
+
+    // the programs, morphed between on the audio thread
+    std::unique_ptr<PresetBank> _presets;
+
+    BypassCrossfade _bypass;
+
+    // off unless JUCE_PROJECTS_FIXED_BLOCK_SIZE is set
+    FixedBlockScheduler _fixedBlocks;
+
+    // meters and spectrum for the editor, idle while it is closed
+    Analyzer _analyzer;
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DistortionAudioProcessor)
 };
@@ -0,0 +1,387 @@
+/*
+  ==============================================================================
+
+    Analyzer.h
+
+    Input and output level meters and an output spectrum, for the editors.
+
+    The audio thread's only part is pushInput() and pushOutput(): each
+    copies a block's channel average into a wait-free single-producer
+    single-consumer FIFO, or drops the block if the FIFO is full. With no
+    editor open they return after one atomic load.
+
+    Everything else runs on one background thread shared by the whole
+    process: draining the FIFOs, peak and RMS ballistics, a Hann window,
+    a 2048-point FFT and spectrum smoothing, throttled to framesPerSecond.
+    The thread only exists while some editor is open, and an instance is
+    only one of its clients while its own editor is, so closed instances
+    never cost a cycle. The FIFOs and FFT buffers are allocated the first
+    time an editor opens.
+
+    Editors register with addViewer() / removeViewer() (AnalyzerView does
+    both) and copy the newest frame out with getLatestFrame().
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <complex>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "DspTables.h"
+
+class Analyzer  : private juce::TimeSliceClient
+{
+public:
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int numBins = fftSize / 2;
+    static constexpr int fifoSize = 1 << 14;
+    static constexpr int framesPerSecond = 30;
+    static constexpr float minDecibels = -100.0f;
+
+    struct Levels
+    {
+        float peak = 0.0f;      // gain, held and decaying
+        float rms = 0.0f;       // gain, smoothed over a few frames
+    };
+
+    struct Frame
+    {
+        Levels input, output;
+        float spectrum[numBins] {};     // dB relative to a full scale sine, per FFT bin
+        double sampleRate = 44100.0;
+        juce::uint32 serial = 0;
+    };
+
+    Analyzer() = default;
+
+    ~Analyzer() override
+    {
+        jassert (mNumViewers.load() == 0);
+
+        if (mThread != nullptr)
+            (*mThread)->removeTimeSliceClient (this);
+    }
+
+    //==============================================================================
+    // audio thread
+
+    /** From prepareToPlay. */
+    void prepare (double sampleRate) noexcept     { mSampleRate.store (sampleRate, std::memory_order_relaxed); }
+
+    /** Before processing. */
+    template <typename FloatType>
+    void pushInput (const juce::AudioBuffer<FloatType>& buffer) noexcept   { push (mStreams[input], buffer); }
+
+    /** After processing. */
+    template <typename FloatType>
+    void pushOutput (const juce::AudioBuffer<FloatType>& buffer) noexcept  { push (mStreams[output], buffer); }
+
+    //==============================================================================
+    // message thread
+
+    void addViewer()
+    {
+        if (mNumViewers.load (std::memory_order_relaxed) == 0)
+        {
+            allocate();
+
+            // whatever is left in the FIFOs from the last time is stale
+            mDiscardBacklog = true;
+
+            mThread = std::make_unique<juce::SharedResourcePointer<AnalyzerThread>>();
+            (*mThread)->addTimeSliceClient (this);
+        }
+
+        // the buffers above are visible to the audio thread once it sees a viewer
+        mNumViewers.fetch_add (1, std::memory_order_release);
+    }
+
+    void removeViewer()
+    {
+        jassert (mNumViewers.load() > 0);
+
+        if (mNumViewers.fetch_sub (1, std::memory_order_relaxed) == 1)
+        {
+            // waits for a time slice in progress, so nothing reads the FIFOs after this
+            (*mThread)->removeTimeSliceClient (this);
+            mThread.reset();
+        }
+    }
+
+    /** Copies the newest frame into frame, if it is newer than the one
+        frame already holds. Returns true if it was.
+    */
+    bool getLatestFrame (Frame& frame) const
+    {
+        const std::lock_guard<std::mutex> lock (mFrameLock);
+
+        if (mPublished.serial == frame.serial)
+            return false;
+
+        frame = mPublished;
+        return true;
+    }
+
+private:
+    enum { input, output };
+
+    struct Stream
+    {
+        juce::AbstractFifo fifo { fifoSize };
+        juce::HeapBlock<float> samples;
+
+        // background thread: what has been drained since the last frame
+        float blockPeak = 0.0f;
+        double sumOfSquares = 0.0;
+        int numDrained = 0;
+
+        // background thread: the meter ballistics
+        float meanSquare = 0.0f;
+        Levels levels;
+    };
+
+    struct AnalyzerThread  : public juce::TimeSliceThread
+    {
+        AnalyzerThread()  : juce::TimeSliceThread ("Plugin analyzer")  { startThread(); }
+        ~AnalyzerThread() override                                     { stopThread (2000); }
+    };
+
+    //==============================================================================
+    template <typename FloatType>
+    void push (Stream& stream, const juce::AudioBuffer<FloatType>& buffer) noexcept
+    {
+        if (mNumViewers.load (std::memory_order_acquire) == 0)
+            return;
+
+        const int numChannels = buffer.getNumChannels();
+        const int numSamples = buffer.getNumSamples();
+
+        if (numChannels == 0 || numSamples == 0 || stream.fifo.getFreeSpace() < numSamples)
+            return;
+
+        int start1, size1, start2, size2;
+        stream.fifo.prepareToWrite (numSamples, start1, size1, start2, size2);
+
+        const float gain = 1.0f / (float) numChannels;
+        downmix (buffer, 0, stream.samples + start1, size1, gain);
+        downmix (buffer, size1, stream.samples + start2, size2, gain);
+
+        stream.fifo.finishedWrite (size1 + size2);
+    }
+
+    static void downmix (const juce::AudioBuffer<float>& buffer, int sourceStart, float* dest, int numSamples, float gain) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+
+        juce::FloatVectorOperations::copyWithMultiply (dest, buffer.getReadPointer (0, sourceStart), gain, numSamples);
+
+        for (int channel = 1; channel < buffer.getNumChannels(); ++channel)
+            juce::FloatVectorOperations::addWithMultiply (dest, buffer.getReadPointer (channel, sourceStart), gain, numSamples);
+    }
+
+    /** The FIFOs hold floats, whatever the host's precision. */
+    static void downmix (const juce::AudioBuffer<double>& buffer, int sourceStart, float* dest, int numSamples, float gain) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+
+        const double doubleGain = (double) gain;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            double sum = 0.0;
+
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                sum += buffer.getReadPointer (channel, sourceStart)[i];
+
+            dest[i] = (float) (sum * doubleGain);
+        }
+    }
+
+    //==============================================================================
+    void allocate()
+    {
+        if (mWindow != nullptr)
+            return;
+
+        for (auto& stream : mStreams)
+            stream.samples.calloc ((size_t) fifoSize);
+
+        mHistory.assign ((size_t) fftSize, 0.0f);
+        mFftData.resize ((size_t) fftSize);
+        mTwiddles.resize ((size_t) fftSize / 2);
+        mBitReversed.resize ((size_t) fftSize);
+
+        for (int i = 0; i < fftSize / 2; ++i)
+            mTwiddles[(size_t) i] = std::polar (1.0f, (float) (-juce::MathConstants<double>::twoPi * i / fftSize));
+
+        for (int i = 0; i < fftSize; ++i)
+        {
+            int reversed = 0;
+
+            for (int bit = 0; bit < fftOrder; ++bit)
+                reversed |= ((i >> bit) & 1) << (fftOrder - 1 - bit);
+
+            mBitReversed[(size_t) i] = reversed;
+        }
+
+        mWindow = mDspTables->get (DspTables::Shape::hannWindow, fftSize).getRow (0);
+
+        for (auto& value : mSpectrum)
+            value = minDecibels;
+    }
+
+    int useTimeSlice() override
+    {
+        if (mDiscardBacklog)
+        {
+            for (auto& stream : mStreams)
+                stream.fifo.finishedRead (stream.fifo.getNumReady());
+
+            mDiscardBacklog = false;
+        }
+
+        drain (mStreams[input], false);
+        drain (mStreams[output], true);
+
+        Frame frame;
+        frame.input = updateLevels (mStreams[input]);
+        frame.output = updateLevels (mStreams[output]);
+        updateSpectrum();
+
+        std::copy (std::begin (mSpectrum), std::end (mSpectrum), frame.spectrum);
+        frame.sampleRate = mSampleRate.load (std::memory_order_relaxed);
+
+        {
+            const std::lock_guard<std::mutex> lock (mFrameLock);
+            frame.serial = mPublished.serial + 1;
+            mPublished = frame;
+        }
+
+        return 1000 / framesPerSecond;
+    }
+
+    void drain (Stream& stream, bool keepHistory) noexcept
+    {
+        int start1, size1, start2, size2;
+        stream.fifo.prepareToRead (stream.fifo.getNumReady(), start1, size1, start2, size2);
+
+        for (auto [start, size] : { std::pair<int, int> (start1, size1), std::pair<int, int> (start2, size2) })
+        {
+            const float* samples = stream.samples + start;
+
+            for (int i = 0; i < size; ++i)
+            {
+                const double sample = (double) samples[i];
+
+                stream.blockPeak = juce::jmax (stream.blockPeak, std::abs (samples[i]));
+                stream.sumOfSquares += sample * sample;
+            }
+
+            stream.numDrained += size;
+
+            if (keepHistory)
+            {
+                for (int i = 0; i < size; ++i)
+                {
+                    mHistory[(size_t) mHistoryPosition] = samples[i];
+                    mHistoryPosition = (mHistoryPosition + 1) & (fftSize - 1);
+                }
+            }
+        }
+
+        stream.fifo.finishedRead (size1 + size2);
+    }
+
+    static Levels updateLevels (Stream& stream) noexcept
+    {
+        // about 20 dB/s of peak fall back and a 100 ms RMS at 30 frames per second
+        constexpr float peakDecay = 0.925f;
+        constexpr float rmsCoefficient = 0.3f;
+
+        const float meanSquare = stream.numDrained > 0 ? (float) (stream.sumOfSquares / stream.numDrained) : 0.0f;
+
+        stream.levels.peak = juce::jmax (stream.blockPeak, stream.levels.peak * peakDecay);
+        stream.meanSquare += rmsCoefficient * (meanSquare - stream.meanSquare);
+        stream.levels.rms = std::sqrt (stream.meanSquare);
+
+        stream.blockPeak = 0.0f;
+        stream.sumOfSquares = 0.0;
+        stream.numDrained = 0;
+
+        return stream.levels;
+    }
+
+    //==============================================================================
+    void updateSpectrum() noexcept
+    {
+        // the newest fftSize output samples, oldest first, windowed, in bit-reversed order
+        for (int i = 0; i < fftSize; ++i)
+            mFftData[(size_t) mBitReversed[(size_t) i]] = mHistory[(size_t) ((mHistoryPosition + i) & (fftSize - 1))] * mWindow[i];
+
+        performFft();
+
+        // the Hann window's gain is 1/2, so a full scale sine comes out at 0 dB
+        constexpr float scale = 4.0f / (float) fftSize;
+        constexpr float fallCoefficient = 0.25f;
+
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            const float decibels = juce::Decibels::gainToDecibels (std::abs (mFftData[(size_t) bin]) * scale, minDecibels);
+            auto& smoothed = mSpectrum[bin];
+
+            smoothed = decibels > smoothed ? decibels : smoothed + fallCoefficient * (decibels - smoothed);
+        }
+    }
+
+    /** In-place radix-2 decimation in time, on input already in bit-reversed order. */
+    void performFft() noexcept
+    {
+        for (int half = 1, twiddleStep = fftSize / 2; half < fftSize; half *= 2, twiddleStep /= 2)
+        {
+            for (int start = 0; start < fftSize; start += 2 * half)
+            {
+                for (int k = 0; k < half; ++k)
+                {
+                    auto& a = mFftData[(size_t) (start + k)];
+                    auto& b = mFftData[(size_t) (start + k + half)];
+                    const auto t = mTwiddles[(size_t) (k * twiddleStep)] * b;
+
+                    b = a - t;
+                    a += t;
+                }
+            }
+        }
+    }
+
+    //==============================================================================
+    std::atomic<int> mNumViewers { 0 };
+    std::atomic<double> mSampleRate { 44100.0 };
+    Stream mStreams[2];
+
+    // message thread
+    std::unique_ptr<juce::SharedResourcePointer<AnalyzerThread>> mThread;
+    juce::SharedResourcePointer<DspTables> mDspTables;
+
+    // background thread
+    bool mDiscardBacklog = false;
+    std::vector<float> mHistory;
+    int mHistoryPosition = 0;
+    std::vector<std::complex<float>> mFftData, mTwiddles;
+    std::vector<int> mBitReversed;
+    const float* mWindow = nullptr;
+    float mSpectrum[numBins];
+
+    mutable std::mutex mFrameLock;
+    Frame mPublished;
+
+    JUCE_DECLARE_NON_COPYABLE (Analyzer)
+};
@@ -0,0 +1,178 @@
+/*
+  ==============================================================================
+
+    AnalyzerView.h
+
+    Draws an Analyzer: the output spectrum on a log frequency axis, and
+    input and output meters (RMS bar, peak line) beside it. While one
+    exists its processor's Analyzer runs, so put one in the editor and
+    nowhere that outlives it.
+
+    It checks for a new frame on every display refresh and repaints only
+    when there is one. The grid, meter troughs and labels come from a
+    cached layer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Analyzer.h"
+#include "EditorRendering.h"
+
+class AnalyzerView  : public juce::Component
+{
+public:
+    static constexpr float minFrequency = 20.0f;
+    static constexpr float meterMinDecibels = -60.0f;
+
+    explicit AnalyzerView (Analyzer& analyzer)  : mAnalyzer (analyzer)
+    {
+        setOpaque (true);
+        mAnalyzer.addViewer();
+    }
+
+    ~AnalyzerView() override
+    {
+        mAnalyzer.removeViewer();
+    }
+
+    void paint (juce::Graphics& g) override
+    {
+        mStaticLayer.draw (g, getLocalBounds(), [this] (juce::Graphics& layer) { paintStaticLayer (layer); });
+
+        const auto areas = getAreas();
+        paintSpectrum (g, areas.spectrum.toFloat());
+        paintMeter (g, areas.inputMeter, mFrame.input);
+        paintMeter (g, areas.outputMeter, mFrame.output);
+    }
+
+private:
+    struct Areas
+    {
+        juce::Rectangle<int> spectrum, inputMeter, outputMeter, inputLabel, outputLabel;
+    };
+
+    Areas getAreas() const
+    {
+        Areas areas;
+        auto area = getLocalBounds().reduced (4);
+        auto meters = area.removeFromRight (44);
+        area.removeFromRight (4);
+
+        areas.spectrum = area;
+        areas.inputMeter = meters.removeFromLeft (20);
+        meters.removeFromLeft (4);
+        areas.outputMeter = meters;
+        areas.inputLabel = areas.inputMeter.removeFromBottom (14);
+        areas.outputLabel = areas.outputMeter.removeFromBottom (14);
+        return areas;
+    }
+
+    void onVBlank()
+    {
+        if (! mAnalyzer.getLatestFrame (mFrame))
+            return;
+
+        if (mFrame.sampleRate != mGridSampleRate)
+        {
+            mGridSampleRate = mFrame.sampleRate;
+            mStaticLayer.invalidate();
+        }
+
+        repaint();
+    }
+
+    /** Everything that doesn't move: background, frequency grid, meter troughs and labels. */
+    void paintStaticLayer (juce::Graphics& g)
+    {
+        g.fillAll (juce::Colours::black);
+
+        const auto areas = getAreas();
+        const auto spectrum = areas.spectrum.toFloat();
+
+        // the grid assumes 44.1 kHz until the first frame says otherwise
+        const auto logRange = std::log ((float) mGridSampleRate * 0.5f / minFrequency);
+
+        g.setColour (juce::Colours::white.withAlpha (0.15f));
+
+        for (float frequency : { 100.0f, 1000.0f, 10000.0f })
+        {
+            const auto x = spectrum.getX() + spectrum.getWidth() * std::log (frequency / minFrequency) / logRange;
+            g.drawVerticalLine ((int) x, spectrum.getY(), spectrum.getBottom());
+        }
+
+        g.setColour (juce::Colours::darkgrey);
+        g.fillRect (areas.inputMeter);
+        g.fillRect (areas.outputMeter);
+
+        g.setColour (juce::Colours::white);
+        g.setFont (12.0f);
+        g.drawText ("In", areas.inputLabel, juce::Justification::centred, false);
+        g.drawText ("Out", areas.outputLabel, juce::Justification::centred, false);
+    }
+
+    void paintSpectrum (juce::Graphics& g, juce::Rectangle<float> area)
+    {
+        const auto nyquist = (float) mFrame.sampleRate * 0.5f;
+        const auto binWidth = (float) mFrame.sampleRate / (float) Analyzer::fftSize;
+        const auto logRange = std::log (nyquist / minFrequency);
+
+        // bins crowd together at the top end, so draw the loudest of each pixel column
+        juce::Path path;
+        int column = -1;
+        float loudest = Analyzer::minDecibels;
+
+        for (int bin = 1; bin < Analyzer::numBins; ++bin)
+        {
+            const auto frequency = bin * binWidth;
+
+            if (frequency < minFrequency)
+                continue;
+
+            const auto x = (int) (area.getX() + area.getWidth() * std::log (frequency / minFrequency) / logRange);
+
+            if (x != column && column >= 0)
+            {
+                const auto y = juce::jmap (loudest, Analyzer::minDecibels, 0.0f, area.getBottom(), area.getY());
+
+                if (path.isEmpty())
+                    path.startNewSubPath ((float) column, y);
+                else
+                    path.lineTo ((float) column, y);
+
+                loudest = Analyzer::minDecibels;
+            }
+
+            column = x;
+            loudest = juce::jmax (loudest, mFrame.spectrum[bin]);
+        }
+
+        g.setColour (juce::Colours::lightgreen);
+        g.strokePath (path, juce::PathStrokeType (1.5f));
+    }
+
+    void paintMeter (juce::Graphics& g, juce::Rectangle<int> area, const Analyzer::Levels& levels)
+    {
+        const auto bar = area.toFloat();
+        const auto toY = [&bar] (float gain)
+        {
+            const auto decibels = juce::jlimit (meterMinDecibels, 0.0f, juce::Decibels::gainToDecibels (gain, meterMinDecibels));
+            return juce::jmap (decibels, meterMinDecibels, 0.0f, bar.getBottom(), bar.getY());
+        };
+
+        g.setColour (levels.peak >= 1.0f ? juce::Colours::red : juce::Colours::lightgreen);
+        g.fillRect (bar.withTop (toY (levels.rms)));
+        g.drawHorizontalLine ((int) toY (levels.peak), bar.getX(), bar.getRight());
+    }
+
+    Analyzer& mAnalyzer;
+    Analyzer::Frame mFrame;
+    double mGridSampleRate = mFrame.sampleRate;
+
+    EditorRendering::CachedLayer mStaticLayer;
+    juce::VBlankAttachment mVBlank { this, [this] { onVBlank(); } };
+
+    JUCE_DECLARE_NON_COPYABLE (AnalyzerView)
+};
@@ -0,0 +1,398 @@
+/*
+  ==============================================================================
+
+    AutomationCapture.h
+
+    Records what a processor receives from its host - the input audio of
+    every block and the parameter changes before it - into a compact binary
+    file, so the headless runner can replay a session bit-exactly.
+
+    Capturing is opt-in: set JUCE_PROJECTS_CAPTURE_DIR in the host's
+    environment and every prepareToPlay starts a new .jpcap file there.
+    The audio thread only copies into a preallocated lock-free FIFO; a
+    background thread writes it to disk. If the writer ever falls behind
+    far enough to fill the FIFO the capture is stopped and flagged as
+    truncated, since a capture with holes could not be replayed exactly.
+
+    File layout (native byte order):
+        "JPAC", int32 version, double sampleRate, int32 numChannels,
+        int32 maxBlockSize, int32 numParameters, numParameters x paramID
+        (null-terminated UTF-8), then records:
+        'P' int32 parameterIndex, float normalisedValue
+        'B' int64 samplePosition, int32 numSamples, numChannels x numSamples floats
+        'b' the same, for a block the host passed to processBlockBypassed
+        'E' end of capture
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace AutomationCaptureFormat
+{
+    static constexpr char magic[4] = { 'J', 'P', 'A', 'C' };
+    // version 2 added bypassedBlockRecord; version 1 files still read
+    static constexpr juce::int32 version = 2;
+
+    enum RecordType : char
+    {
+        parameterRecord     = 'P',
+        blockRecord         = 'B',
+        bypassedBlockRecord = 'b',
+        endRecord           = 'E'
+    };
+
+    static constexpr int parameterRecordSize = 1 + (int) sizeof (juce::int32) + (int) sizeof (float);
+    static constexpr int blockRecordHeaderSize = 1 + (int) sizeof (juce::int64) + (int) sizeof (juce::int32);
+
+    inline juce::String getParameterID (juce::AudioProcessorParameter& parameter)
+    {
+        if (auto* withID = dynamic_cast<juce::AudioProcessorParameterWithID*> (&parameter))
+            return withID->paramID;
+
+        return juce::String (parameter.getParameterIndex());
+    }
+}
+
+//==============================================================================
+class AutomationCapture  : private juce::Thread
+{
+public:
+    AutomationCapture() : juce::Thread ("Automation capture") {}
+
+    ~AutomationCapture() override
+    {
+        stop();
+    }
+
+    /** Starts a capture if JUCE_PROJECTS_CAPTURE_DIR is set. Call from prepareToPlay. */
+    void startFromEnvironment (juce::AudioProcessor& processor, double sampleRate, int maxBlockSize)
+    {
+        stop();
+
+        auto directory = juce::SystemStats::getEnvironmentVariable ("JUCE_PROJECTS_CAPTURE_DIR", {});
+
+        if (directory.isEmpty())
+            return;
+
+        auto file = juce::File (directory)
+                        .getChildFile (processor.getName() + "-" + juce::Time::getCurrentTime().formatted ("%Y%m%d-%H%M%S") + ".jpcap")
+                        .getNonexistentSibling();
+
+        start (file, processor, sampleRate, processor.getTotalNumInputChannels(), maxBlockSize);
+    }
+
+    /** Must not be called while processBlock may be running (e.g. from prepareToPlay). */
+    bool start (const juce::File& file, juce::AudioProcessor& processor, double sampleRate, int numChannels, int maxBlockSize)
+    {
+        stop();
+
+        if (! file.getParentDirectory().createDirectory().wasOk())
+            return false;
+
+        file.deleteFile();
+        auto stream = std::make_unique<juce::FileOutputStream> (file);
+
+        if (! stream->openedOk())
+            return false;
+
+        auto& parameters = processor.getParameters();
+
+        stream->write (AutomationCaptureFormat::magic, sizeof (AutomationCaptureFormat::magic));
+        writeValue (*stream, AutomationCaptureFormat::version);
+        writeValue (*stream, sampleRate);
+        writeValue (*stream, (juce::int32) numChannels);
+        writeValue (*stream, (juce::int32) maxBlockSize);
+        writeValue (*stream, (juce::int32) parameters.size());
+
+        for (auto* parameter : parameters)
+            stream->writeString (AutomationCaptureFormat::getParameterID (*parameter));
+
+        mStream = std::move (stream);
+        mNumChannels = numChannels;
+        mNumParameters = parameters.size();
+        mPosition = 0;
+        mTruncated.store (false, std::memory_order_relaxed);
+
+        // NaN never compares equal, so every parameter is written before the first block
+        mValues.malloc ((size_t) juce::jmax (1, mNumParameters));
+        mLastValues.malloc ((size_t) juce::jmax (1, mNumParameters));
+        for (int i = 0; i < mNumParameters; ++i)
+            mLastValues[i] = std::numeric_limits<float>::quiet_NaN();
+
+        // a few seconds of audio, so that a stalled disk doesn't truncate the capture immediately
+        auto capacity = juce::jmax (1 << 20, (int) (sampleRate * 4.0) * (int) sizeof (float) * juce::jmax (1, numChannels));
+        mFifoData.malloc ((size_t) capacity);
+        mFifo.setTotalSize (capacity);
+        mFifo.reset();
+
+        mCapturing.store (true, std::memory_order_release);
+        startThread();
+        return true;
+    }
+
+    /** Must not be called while processBlock may be running (e.g. from releaseResources). */
+    void stop()
+    {
+        if (mStream == nullptr)
+            return;
+
+        mCapturing.store (false, std::memory_order_release);
+        stopThread (2000);
+        drainFifo();
+
+        writeValue (*mStream, (char) AutomationCaptureFormat::endRecord);
+        mStream->flush();
+
+        if (mTruncated.load (std::memory_order_relaxed))
+            DBG ("automation capture truncated, the writer fell behind: " << mStream->getFile().getFullPathName());
+
+        mStream.reset();
+    }
+
+    bool isCapturing() const noexcept  { return mCapturing.load (std::memory_order_relaxed); }
+
+    /** Call once per host block, from processBlock or processBlockBypassed
+        (saying which), before the buffer is processed in place. Double
+        precision input is recorded as floats.
+    */
+    template <typename FloatType>
+    void captureBlock (const juce::AudioBuffer<FloatType>& input, const juce::Array<juce::AudioProcessorParameter*>& parameters,
+                       bool bypassed) noexcept
+    {
+        if (! mCapturing.load (std::memory_order_acquire))
+            return;
+
+        const int numSamples = input.getNumSamples();
+        const int numParameters = juce::jmin (mNumParameters, parameters.size());
+        int numChanged = 0;
+
+        // read once: the host or the message thread may move a parameter at
+        // any time, and the records pushed must be the ones counted here
+        for (int i = 0; i < numParameters; ++i)
+        {
+            mValues[i] = parameters.getUnchecked (i)->getValue();
+
+            if (mValues[i] != mLastValues[i])
+                ++numChanged;
+        }
+
+        const int numBytes = numChanged * AutomationCaptureFormat::parameterRecordSize
+                           + AutomationCaptureFormat::blockRecordHeaderSize
+                           + mNumChannels * numSamples * (int) sizeof (float);
+
+        if (mFifo.getFreeSpace() < numBytes)
+        {
+            mTruncated.store (true, std::memory_order_relaxed);
+            mCapturing.store (false, std::memory_order_release);
+            return;
+        }
+
+        for (int i = 0; i < numParameters; ++i)
+        {
+            const auto value = mValues[i];
+
+            if (value != mLastValues[i])
+            {
+                mLastValues[i] = value;
+                push ((char) AutomationCaptureFormat::parameterRecord);
+                push ((juce::int32) i);
+                push (value);
+            }
+        }
+
+        push ((char) (bypassed ? AutomationCaptureFormat::bypassedBlockRecord : AutomationCaptureFormat::blockRecord));
+        push ((juce::int64) mPosition);
+        push ((juce::int32) numSamples);
+
+        for (int channel = 0; channel < mNumChannels; ++channel)
+        {
+            if (channel < input.getNumChannels())
+            {
+                pushSamples (input.getReadPointer (channel), numSamples);
+            }
+            else
+            {
+                for (int i = 0; i < numSamples; ++i)
+                    push (0.0f);
+            }
+        }
+
+        mPosition += numSamples;
+    }
+
+private:
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            drainFifo();
+            wait (20);
+        }
+    }
+
+    void drainFifo()
+    {
+        int start1, size1, start2, size2;
+        mFifo.prepareToRead (mFifo.getNumReady(), start1, size1, start2, size2);
+
+        if (size1 > 0)  mStream->write (mFifoData + start1, (size_t) size1);
+        if (size2 > 0)  mStream->write (mFifoData + start2, (size_t) size2);
+
+        mFifo.finishedRead (size1 + size2);
+    }
+
+    void pushSamples (const float* samples, int numSamples) noexcept
+    {
+        pushBytes (samples, numSamples * (int) sizeof (float));
+    }
+
+    void pushSamples (const double* samples, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            push ((float) samples[i]);
+    }
+
+    void pushBytes (const void* data, int numBytes) noexcept
+    {
+        int start1, size1, start2, size2;
+        mFifo.prepareToWrite (numBytes, start1, size1, start2, size2);
+
+        std::memcpy (mFifoData + start1, data, (size_t) size1);
+        std::memcpy (mFifoData + start2, static_cast<const char*> (data) + size1, (size_t) size2);
+
+        mFifo.finishedWrite (size1 + size2);
+    }
+
+    template <typename Type>
+    void push (Type value) noexcept
+    {
+        pushBytes (&value, (int) sizeof (Type));
+    }
+
+    template <typename Type>
+    static void writeValue (juce::OutputStream& stream, Type value)
+    {
+        stream.write (&value, sizeof (Type));
+    }
+
+    std::unique_ptr<juce::FileOutputStream> mStream;
+    juce::AbstractFifo mFifo { 1 };
+    juce::HeapBlock<char> mFifoData;
+    juce::HeapBlock<float> mValues, mLastValues;
+
+    std::atomic<bool> mCapturing { false };
+    std::atomic<bool> mTruncated { false };
+    int mNumChannels = 0;
+    int mNumParameters = 0;
+    juce::int64 mPosition = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AutomationCapture)
+};
+
+//==============================================================================
+/** Reads a .jpcap file record by record, for the headless runner. */
+class AutomationCaptureReader
+{
+public:
+    bool open (const juce::File& file)
+    {
+        mStream = std::make_unique<juce::FileInputStream> (file);
+
+        if (! mStream->openedOk())
+            return false;
+
+        char magic[4] = {};
+        juce::int32 version = 0;
+
+        if (mStream->read (magic, 4) != 4 || std::memcmp (magic, AutomationCaptureFormat::magic, 4) != 0
+             || ! readValue (version) || ! juce::isPositiveAndNotGreaterThan (version, AutomationCaptureFormat::version)
+             || ! readValue (sampleRate) || ! readValue (numChannels)
+             || ! readValue (maxBlockSize) || ! readValue (numParameters))
+            return false;
+
+        for (int i = 0; i < numParameters; ++i)
+            parameterIDs.add (mStream->readString());
+
+        return sampleRate > 0.0 && numChannels >= 0 && maxBlockSize > 0 && ! mStream->isExhausted();
+    }
+
+    struct Record
+    {
+        AutomationCaptureFormat::RecordType type = AutomationCaptureFormat::endRecord;
+        juce::int32 parameterIndex = 0;
+        float parameterValue = 0.0f;
+        juce::int64 samplePosition = 0;
+        juce::int32 numSamples = 0;
+        bool bypassed = false;
+    };
+
+    /** Reads the next record. For a block record, the audio follows and must be read with readBlock(). */
+    bool readNextRecord (Record& record)
+    {
+        char type = 0;
+
+        if (! readValue (type))
+            return false;
+
+        record.type = (AutomationCaptureFormat::RecordType) type;
+        record.bypassed = record.type == AutomationCaptureFormat::bypassedBlockRecord;
+
+        // both kinds of block are read alike
+        if (record.bypassed)
+            record.type = AutomationCaptureFormat::blockRecord;
+
+        switch (record.type)
+        {
+            case AutomationCaptureFormat::parameterRecord:
+                return readValue (record.parameterIndex) && readValue (record.parameterValue);
+
+            case AutomationCaptureFormat::blockRecord:
+                return readValue (record.samplePosition) && readValue (record.numSamples)
+                        && juce::isPositiveAndBelow (record.numSamples, maxBlockSize + 1);
+
+            case AutomationCaptureFormat::endRecord:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    bool readBlock (juce::AudioBuffer<float>& buffer, int numSamples)
+    {
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto numBytes = numSamples * (int) sizeof (float);
+
+            if (channel < buffer.getNumChannels())
+            {
+                if (mStream->read (buffer.getWritePointer (channel), numBytes) != numBytes)
+                    return false;
+            }
+            else if (! mStream->setPosition (mStream->getPosition() + numBytes))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    double sampleRate = 0.0;
+    juce::int32 numChannels = 0;
+    juce::int32 maxBlockSize = 0;
+    juce::int32 numParameters = 0;
+    juce::StringArray parameterIDs;
+
+private:
+    template <typename Type>
+    bool readValue (Type& value)
+    {
+        return mStream->read (&value, (int) sizeof (Type)) == (int) sizeof (Type);
+    }
+
+    std::unique_ptr<juce::FileInputStream> mStream;
+};
@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+
+    BypassCrossfade.h
+
+    Host bypass without a click and without paying for the effect. Both
+    processBlock and processBlockBypassed hand their buffer to process(),
+    along with two callbacks:
+
+        effect     the processor's full DSP
+        keepAlive  what a bypassed processor still does, in place of the
+                   DSP, e.g. keep writing its input into its delay lines
+                   so there's no gap when it comes back. It leaves the
+                   buffer (the dry signal) alone.
+
+    On a change of bypass state, the first fadeSeconds of audio run
+    through the effect and are crossfaded with a copy of the dry input.
+    After that a bypassed processor only runs keepAlive.
+
+    process() takes float or double buffers, whichever the host uses.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <tuple>
+
+class BypassCrossfade
+{
+public:
+    static constexpr double fadeSeconds = 0.005;
+
+    /** From prepareToPlay. Finishes any fade that was under way. */
+    void prepare (double sampleRate, int numChannels)
+    {
+        mFadeLength = juce::jmax (1, juce::roundToInt (fadeSeconds * sampleRate));
+        std::get<juce::AudioBuffer<float>> (mDry).setSize (numChannels, mFadeLength);
+        std::get<juce::AudioBuffer<double>> (mDry).setSize (numChannels, mFadeLength);
+        mFadePosition = mBypassed ? 0 : mFadeLength;
+    }
+
+    bool isBypassed() const noexcept  { return mBypassed; }
+
+    template <typename FloatType, typename Effect, typename KeepAlive>
+    void process (juce::AudioBuffer<FloatType>& buffer, bool bypassed, Effect&& effect, KeepAlive&& keepAlive)
+    {
+        mBypassed = bypassed;
+
+        // mFadePosition / mFadeLength is the effect's share of the output
+        const int target = bypassed ? 0 : mFadeLength;
+        const int numSamples = buffer.getNumSamples();
+
+        if (mFadePosition == target)
+        {
+            if (bypassed)
+                keepAlive (buffer);
+            else
+                effect (buffer);
+
+            return;
+        }
+
+        auto& dryBuffer = std::get<juce::AudioBuffer<FloatType>> (mDry);
+        const int fadeSamples = juce::jmin (numSamples, std::abs (target - mFadePosition));
+        const int numChannels = juce::jmin (buffer.getNumChannels(), dryBuffer.getNumChannels());
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            dryBuffer.copyFrom (channel, 0, buffer, channel, 0, fadeSamples);
+
+        {
+            // refers to the start of buffer, no allocation below 32 channels
+            juce::AudioBuffer<FloatType> fade (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), 0, fadeSamples);
+            effect (fade);
+        }
+
+        const int step = bypassed ? -1 : 1;
+        const FloatType scale = FloatType (1) / (FloatType) mFadeLength;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            FloatType* out = buffer.getWritePointer (channel);
+            const FloatType* dry = dryBuffer.getReadPointer (channel);
+
+            for (int i = 0; i < fadeSamples; ++i)
+            {
+                const FloatType gain = (FloatType) (mFadePosition + step * (i + 1)) * scale;
+                out[i] = dry[i] + gain * (out[i] - dry[i]);
+            }
+        }
+
+        mFadePosition += step * fadeSamples;
+
+        if (fadeSamples < numSamples)
+        {
+            juce::AudioBuffer<FloatType> rest (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), fadeSamples, numSamples - fadeSamples);
+
+            if (bypassed)
+                keepAlive (rest);
+            else
+                effect (rest);
+        }
+    }
+
+private:
+    std::tuple<juce::AudioBuffer<float>, juce::AudioBuffer<double>> mDry;
+    int mFadeLength = 1;
+    int mFadePosition = 1;
+    bool mBypassed = false;
+};
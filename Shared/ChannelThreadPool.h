@@ -0,0 +1,160 @@
+/*
+  ==============================================================================
+
+    ChannelThreadPool.h
+
+    A small persistent pool that runs one task per channel (or channel
+    group) in parallel during offline renders. The calling thread works too,
+    and idle threads take the next unclaimed task from a shared atomic
+    counter, so a slow channel never holds the others up.
+
+    Workers sleep on a condition variable between blocks, so this must
+    only be used when the host says it is rendering offline
+    (AudioProcessor::isNonRealtime()), never on the real-time path.
+
+    Opt-in: a processor only creates a pool once setParallelChannels (see
+    ProcessorOptions.h) has asked for one, which is the default for every
+    instance when JUCE_PROJECTS_PARALLEL_OFFLINE=1 is set in the host's
+    environment.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class ChannelThreadPool
+{
+public:
+    explicit ChannelThreadPool (int numWorkerThreads)
+    {
+        for (int i = 0; i < numWorkerThreads; ++i)
+            mWorkers.emplace_back ([this] { workerLoop(); });
+    }
+
+    ~ChannelThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock (mLock);
+            mShouldExit = true;
+        }
+
+        mWake.notify_all();
+
+        for (auto& worker : mWorkers)
+            worker.join();
+    }
+
+    static bool isRequestedByEnvironment()
+    {
+        return juce::SystemStats::getEnvironmentVariable ("JUCE_PROJECTS_PARALLEL_OFFLINE", {}).getIntValue() != 0;
+    }
+
+    /** A pool sized for this many channels and this machine, or nullptr if
+        it wouldn't help (one channel, or one CPU).
+    */
+    static std::unique_ptr<ChannelThreadPool> createForChannels (int numChannels)
+    {
+        auto numWorkers = juce::jmin (numChannels, juce::SystemStats::getNumCpus()) - 1;
+
+        if (numWorkers <= 0)
+            return {};
+
+        return std::make_unique<ChannelThreadPool> (numWorkers);
+    }
+
+    int getNumWorkerThreads() const noexcept  { return (int) mWorkers.size(); }
+
+    /** Calls task (index) for every index in [0, numTasks) and returns once all have finished. */
+    template <typename Task>
+    void forEach (int numTasks, Task& task)
+    {
+        if (numTasks <= 1 || mWorkers.empty())
+        {
+            for (int i = 0; i < numTasks; ++i)
+                task (i);
+
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock (mLock);
+            mTask = &task;
+            mInvoke = [] (void* t, int index) { (*static_cast<Task*> (t)) (index); };
+            mNumTasks = numTasks;
+            mNextTask = 0;
+            mNumWorkersFinished = 0;
+            ++mGeneration;
+        }
+
+        mWake.notify_all();
+        runTasks();
+
+        // every worker has to check in, so none of them can still be touching
+        // the task counter when the next call resets it
+        std::unique_lock<std::mutex> lock (mLock);
+        mFinished.wait (lock, [this] { return mNumWorkersFinished == (int) mWorkers.size(); });
+    }
+
+private:
+    void runTasks()
+    {
+        for (;;)
+        {
+            auto index = mNextTask.fetch_add (1);
+
+            if (index >= mNumTasks)
+                return;
+
+            mInvoke (mTask, index);
+        }
+    }
+
+    void workerLoop()
+    {
+        // the flush-to-zero mode is per thread: the caller's
+        // ScopedNoDenormals in processBlock doesn't reach the workers
+        juce::ScopedNoDenormals noDenormals;
+        juce::uint64 lastGeneration = 0;
+
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock (mLock);
+                mWake.wait (lock, [&] { return mShouldExit || mGeneration != lastGeneration; });
+
+                if (mShouldExit)
+                    return;
+
+                lastGeneration = mGeneration;
+            }
+
+            runTasks();
+
+            {
+                std::lock_guard<std::mutex> lock (mLock);
+                ++mNumWorkersFinished;
+            }
+
+            mFinished.notify_one();
+        }
+    }
+
+    std::vector<std::thread> mWorkers;
+    std::mutex mLock;
+    std::condition_variable mWake, mFinished;
+
+    void* mTask = nullptr;
+    void (*mInvoke) (void*, int) = nullptr;
+    int mNumTasks = 0;
+    std::atomic<int> mNextTask { 0 };
+    int mNumWorkersFinished = 0;
+    juce::uint64 mGeneration = 0;
+    bool mShouldExit = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChannelThreadPool)
+};
@@ -0,0 +1,142 @@
+/*
+  ==============================================================================
+
+    CpuDispatch.h
+
+    Picks the widest instruction set the CPU supports once, the first time
+    the table is asked for (plugins do that in their constructor), and hands
+    out a table of kernel function pointers for it. One binary then runs
+    the AVX-512 kernels on new render nodes and SSE2 on old ones.
+
+    Set JUCE_PROJECTS_ISA to scalar, sse2, avx2 or avx512 to force a lower
+    instruction set for testing. A request for something the CPU can't run
+    falls back to the best one it can.
+
+    The table is float only. The mix and shape functions at the bottom
+    take either sample type: floats go through the table, doubles run the
+    scalar kernels. svfLanes has no double version, call it through the
+    table.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "DspKernels.h"
+
+namespace CpuDispatch
+{
+    enum class Isa
+    {
+        scalar,
+        sse2,
+        avx2,
+        avx512
+    };
+
+    struct Kernels
+    {
+        Isa isa;
+        void (*mix) (float* dryInOut, const float* wet, float dryGain, float wetGain, int numSamples) noexcept;
+        void (*shapeAtan) (float* dest, const float* src, float inputGain, int numSamples) noexcept;
+        void (*shapeRational) (float* dest, const float* src, float inputGain, int numSamples) noexcept;
+        void (*svfLanes) (DspKernels::SvfLanes& filters, const float* input, float* output, float* scaled, int numSamples) noexcept;
+    };
+
+    inline const char* getIsaName (Isa isa) noexcept
+    {
+        switch (isa)
+        {
+            case Isa::sse2:   return "sse2";
+            case Isa::avx2:   return "avx2";
+            case Isa::avx512: return "avx512";
+            case Isa::scalar: break;
+        }
+
+        return "scalar";
+    }
+
+    inline Isa getBestSupportedIsa()
+    {
+       #if JUCE_INTEL
+        if (juce::SystemStats::hasAVX512F())  return Isa::avx512;
+        if (juce::SystemStats::hasAVX2())     return Isa::avx2;
+        if (juce::SystemStats::hasSSE2())     return Isa::sse2;
+       #endif
+
+        return Isa::scalar;
+    }
+
+    inline Isa detectIsa()
+    {
+        auto best = getBestSupportedIsa();
+        auto requested = juce::SystemStats::getEnvironmentVariable ("JUCE_PROJECTS_ISA", {}).trim().toLowerCase();
+
+        for (auto isa : { Isa::scalar, Isa::sse2, Isa::avx2, Isa::avx512 })
+            if (requested == getIsaName (isa))
+                return juce::jmin (isa, best);
+
+        return best;
+    }
+
+    /** The table for a given instruction set, whether or not this CPU can run it. */
+    inline Kernels getKernelsFor (Isa isa) noexcept
+    {
+        switch (isa)
+        {
+           #if JUCE_INTEL
+            case Isa::avx512: return { isa, DspKernels::avx512::mix, DspKernels::avx512::shapeAtan, DspKernels::avx512::shapeRational, DspKernels::avx512::svfLanes };
+            case Isa::avx2:   return { isa, DspKernels::avx2::mix,   DspKernels::avx2::shapeAtan,   DspKernels::avx2::shapeRational,   DspKernels::avx2::svfLanes };
+            case Isa::sse2:   return { isa, DspKernels::sse2::mix,   DspKernels::sse2::shapeAtan,   DspKernels::sse2::shapeRational,   DspKernels::sse2::svfLanes };
+           #endif
+            default:          break;
+        }
+
+        return { Isa::scalar, DspKernels::scalar::mix<float>, DspKernels::scalar::shapeAtan<float>, DspKernels::scalar::shapeRational<float>,
+                 DspKernels::scalar::svfLanes };
+    }
+
+    /** The table for this machine, selected on first use and shared by all instances. */
+    inline const Kernels& getKernels()
+    {
+        static const Kernels kernels = []
+        {
+            auto table = getKernelsFor (detectIsa());
+            DBG ("DSP kernels: " << getIsaName (table.isa));
+            return table;
+        }();
+
+        return kernels;
+    }
+
+    //==============================================================================
+    inline void mix (const Kernels& kernels, float* dryInOut, const float* wet, float dryGain, float wetGain, int numSamples) noexcept
+    {
+        kernels.mix (dryInOut, wet, dryGain, wetGain, numSamples);
+    }
+
+    inline void mix (const Kernels&, double* dryInOut, const double* wet, double dryGain, double wetGain, int numSamples) noexcept
+    {
+        DspKernels::scalar::mix (dryInOut, wet, dryGain, wetGain, numSamples);
+    }
+
+    inline void shapeAtan (const Kernels& kernels, float* dest, const float* src, float inputGain, int numSamples) noexcept
+    {
+        kernels.shapeAtan (dest, src, inputGain, numSamples);
+    }
+
+    inline void shapeAtan (const Kernels&, double* dest, const double* src, double inputGain, int numSamples) noexcept
+    {
+        DspKernels::scalar::shapeAtan (dest, src, inputGain, numSamples);
+    }
+
+    inline void shapeRational (const Kernels& kernels, float* dest, const float* src, float inputGain, int numSamples) noexcept
+    {
+        kernels.shapeRational (dest, src, inputGain, numSamples);
+    }
+
+    inline void shapeRational (const Kernels&, double* dest, const double* src, double inputGain, int numSamples) noexcept
+    {
+        DspKernels::scalar::shapeRational (dest, src, inputGain, numSamples);
+    }
+}
@@ -0,0 +1,255 @@
+/*
+  ==============================================================================
+
+    DelayMemoryPool.h
+
+    One process-wide pool for the big per-instance delay line buffers.
+    Instances lease their memory in prepareToPlay and hand it back in
+    releaseResources, so suspended or idle instances in a large session
+    don't keep megabytes each.
+
+    Blocks are 64-byte aligned and come in size classes a quarter octave
+    apart (at most 25% slack), so a returned block is usually a fit for the
+    next instance that prepares. Up to maxCachedPerClass blocks per class
+    are kept for reuse; the rest go straight back to the system.
+
+    An optional budget (setBudget, or JUCE_PROJECTS_DELAY_MEMORY_BUDGET_MB)
+    caps leased plus cached memory. A lease that would go over it first
+    frees the cache, then fails. Callers treat an empty lease like having
+    no delay line at all, and pass audio through.
+
+    Leasing and returning take a lock, so they belong in prepareToPlay and
+    releaseResources, never in processBlock.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <mutex>
+#include <new>
+#include <utility>
+
+class DelayMemoryPool
+{
+public:
+    static constexpr size_t alignment = 64;
+    static constexpr size_t minimumBlockSize = 4096;
+    static constexpr int maxCachedPerClass = 4;
+
+    //==============================================================================
+    /** Owns a block until destroyed or reset. */
+    class Lease
+    {
+    public:
+        Lease() = default;
+
+        Lease (Lease&& other) noexcept
+            : mPool (std::exchange (other.mPool, nullptr)),
+              mData (std::exchange (other.mData, nullptr)),
+              mSize (std::exchange (other.mSize, 0))
+        {
+        }
+
+        Lease& operator= (Lease&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                mPool = std::exchange (other.mPool, nullptr);
+                mData = std::exchange (other.mData, nullptr);
+                mSize = std::exchange (other.mSize, 0);
+            }
+
+            return *this;
+        }
+
+        ~Lease()  { reset(); }
+
+        void reset()
+        {
+            if (mPool != nullptr)
+                mPool->giveBack (mData, mSize);
+
+            mPool = nullptr;
+            mData = nullptr;
+            mSize = 0;
+        }
+
+        bool isValid() const noexcept   { return mData != nullptr; }
+        size_t getSize() const noexcept { return mSize; }
+
+        template <typename Type>
+        Type* getAs() const noexcept    { return static_cast<Type*> (mData); }
+
+    private:
+        friend class DelayMemoryPool;
+
+        Lease (DelayMemoryPool& pool, void* data, size_t size) noexcept
+            : mPool (&pool), mData (data), mSize (size) {}
+
+        DelayMemoryPool* mPool = nullptr;
+        void* mData = nullptr;
+        size_t mSize = 0;
+
+        JUCE_DECLARE_NON_COPYABLE (Lease)
+    };
+
+    struct Usage
+    {
+        size_t bytesLeased = 0;
+        size_t bytesCached = 0;
+        size_t peakBytesLeased = 0;
+        size_t budget = 0;          // 0 if unlimited
+        int numLeases = 0;
+        int numFailedLeases = 0;
+    };
+
+    //==============================================================================
+    DelayMemoryPool()
+    {
+        mBudget = (size_t) juce::jmax (0, juce::SystemStats::getEnvironmentVariable ("JUCE_PROJECTS_DELAY_MEMORY_BUDGET_MB", {}).getIntValue())
+                    * 1024 * 1024;
+    }
+
+    ~DelayMemoryPool()
+    {
+        // every lease must be gone by now: they point back here
+        jassert (mUsage.numLeases == 0);
+        trim();
+    }
+
+    /** At least numBytes of zeroed memory, or an empty lease if the budget won't allow it. */
+    Lease lease (size_t numBytes)
+    {
+        const auto size = getBlockSize (numBytes);
+        void* data = nullptr;
+
+        {
+            const std::lock_guard<std::mutex> lock (mLock);
+
+            auto& cached = mCache[size];
+
+            if (! cached.empty())
+            {
+                data = cached.back();
+                cached.pop_back();
+                mUsage.bytesCached -= size;
+            }
+            else
+            {
+                if (mBudget > 0 && mUsage.bytesLeased + mUsage.bytesCached + size > mBudget)
+                    trimLocked();
+
+                if (mBudget > 0 && mUsage.bytesLeased + size > mBudget)
+                {
+                    ++mUsage.numFailedLeases;
+                    return {};
+                }
+
+                data = ::operator new (size, std::align_val_t (alignment), std::nothrow);
+
+                if (data == nullptr)
+                {
+                    ++mUsage.numFailedLeases;
+                    return {};
+                }
+            }
+
+            mUsage.bytesLeased += size;
+            mUsage.peakBytesLeased = juce::jmax (mUsage.peakBytesLeased, mUsage.bytesLeased);
+            ++mUsage.numLeases;
+        }
+
+        std::memset (data, 0, size);
+        return { *this, data, size };
+    }
+
+    Usage getUsage() const
+    {
+        const std::lock_guard<std::mutex> lock (mLock);
+        auto usage = mUsage;
+        usage.budget = mBudget;
+        return usage;
+    }
+
+    /** 0 for no limit. Only affects leases from now on. */
+    void setBudget (size_t numBytes)
+    {
+        const std::lock_guard<std::mutex> lock (mLock);
+        mBudget = numBytes;
+    }
+
+    /** Frees every cached block. */
+    void trim()
+    {
+        const std::lock_guard<std::mutex> lock (mLock);
+        trimLocked();
+    }
+
+    /** Elements per channel for numElements-long channels laid out back to
+        back in one lease, so that every channel starts on a cache line. */
+    template <typename Type>
+    static int getAlignedStride (int numElements) noexcept
+    {
+        constexpr auto elementsPerLine = (int) (alignment / sizeof (Type));
+        return (numElements + elementsPerLine - 1) / elementsPerLine * elementsPerLine;
+    }
+
+    /** The size class numBytes falls into: 4, 5, 6 or 7 quarters of a power of two. */
+    static size_t getBlockSize (size_t numBytes) noexcept
+    {
+        numBytes = juce::jmax (numBytes, minimumBlockSize);
+
+        size_t octave = minimumBlockSize;
+
+        while (octave * 2 <= numBytes)
+            octave *= 2;
+
+        for (size_t quarters = 4; quarters < 8; ++quarters)
+            if (octave / 4 * quarters >= numBytes)
+                return octave / 4 * quarters;
+
+        return octave * 2;
+    }
+
+private:
+    void giveBack (void* data, size_t size)
+    {
+        const std::lock_guard<std::mutex> lock (mLock);
+
+        mUsage.bytesLeased -= size;
+        --mUsage.numLeases;
+
+        auto& cached = mCache[size];
+
+        if ((int) cached.size() < maxCachedPerClass && (mBudget == 0 || mUsage.bytesLeased + mUsage.bytesCached + size <= mBudget))
+        {
+            cached.push_back (data);
+            mUsage.bytesCached += size;
+        }
+        else
+        {
+            ::operator delete (data, std::align_val_t (alignment));
+        }
+    }
+
+    void trimLocked()
+    {
+        for (auto& sizeAndBlocks : mCache)
+            for (auto* block : sizeAndBlocks.second)
+                ::operator delete (block, std::align_val_t (alignment));
+
+        mCache.clear();
+        mUsage.bytesCached = 0;
+    }
+
+    mutable std::mutex mLock;
+    std::map<size_t, std::vector<void*>> mCache;
+    Usage mUsage;
+    size_t mBudget = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (DelayMemoryPool)
+};
@@ -0,0 +1,588 @@
+/*
+  ==============================================================================
+
+    DspKernels.h
+
+    The vectorisable inner loops shared by the plugins, compiled once per
+    instruction set. Don't call these directly, go through the table in
+    CpuDispatch.h, which only hands out variants the CPU supports.
+
+    All variants use the same operations in the same order and none of them
+    uses FMA (contraction is switched off below for GCC and Clang, and MSVC
+    doesn't contract unless asked to), so they produce bit-identical results
+    and a capture replays the same on every machine.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+#if JUCE_INTEL && (JUCE_GCC || JUCE_CLANG)
+ #define JUCE_PROJECTS_TARGET(isa)  __attribute__ ((target (isa)))
+#else
+ #define JUCE_PROJECTS_TARGET(isa)
+#endif
+
+// the compiler would otherwise fuse the multiplies and adds into FMA in the
+// AVX2 and AVX-512 variants (avx512f implies fma) and they'd no longer match
+// the others. GCC and Clang both contract by default
+#if JUCE_GCC
+ #pragma GCC push_options
+ #pragma GCC optimize ("fp-contract=off")
+#elif JUCE_CLANG
+ #pragma float_control (push)
+ #pragma clang fp contract (off)
+#endif
+
+namespace DspKernels
+{
+    // minimax fit of atan on [-1, 1] (Abramowitz & Stegun 4.4.49), max error under 2e-6 rad
+    static constexpr float atanC0 =  0.99997726f;
+    static constexpr float atanC1 = -0.33262347f;
+    static constexpr float atanC2 =  0.19354346f;
+    static constexpr float atanC3 = -0.11643287f;
+    static constexpr float atanC4 =  0.05265332f;
+    static constexpr float atanC5 = -0.01172120f;
+    static constexpr float halfPi = 1.57079632679f;
+    static constexpr float twoOverPi = 0.63661977236f;
+
+    // 2/pi * atan (x) ~= x (2/pi + a|x|) / (1 + b|x| + a x^2), max error 0.0033: the cheap shaper
+    static constexpr float rationalA = 0.82552826f;
+    static constexpr float rationalB = 1.1075f;
+
+    /** Lanes of cascaded TPT state variable filters (Zavalishin's topology
+        preserving transform), advanced together. Each of the numStages
+        stages has one set of coefficients for all lanes, and each lane
+        passes on its own mix of the stage's low, band and high pass outputs
+        to the next stage. Samples are interleaved, lanes fastest, so a
+        vector of lanes is one load. LinkwitzRiley.h builds its crossovers
+        out of these.
+    */
+    struct SvfLanes
+    {
+        static constexpr int maxStages = 6;
+        static constexpr int maxLanes = 32;
+
+        int numLanes = 0;
+        int numStages = 0;
+
+        // g = tan (pi fc / fs), a1 = 1 / (1 + g (g + k)), a2 = g a1, a3 = g a2, k = 1/Q
+        float a1[maxStages] {}, a2[maxStages] {}, a3[maxStages] {}, k[maxStages] {};
+        float low[maxStages][maxLanes] {}, band[maxStages][maxLanes] {}, high[maxStages][maxLanes] {};
+
+        // per lane gain for the scaled copy of the output
+        float gain[maxLanes] {};
+
+        float ic1[maxStages][maxLanes] {}, ic2[maxStages][maxLanes] {};
+    };
+
+    /** Templated on the sample type: the vector variants below use the float
+        instantiations, and double precision processing runs the double ones,
+        with the same (float accurate) coefficients so both precisions shape alike.
+    */
+    namespace scalar
+    {
+        template <typename FloatType>
+        inline FloatType atan (FloatType x) noexcept
+        {
+            const auto one = FloatType (1);
+
+            auto a = std::abs (x);
+            auto invert = a > one;
+            auto z = invert ? one / a : a;
+            auto z2 = z * z;
+            auto p = z * (FloatType (atanC0) + z2 * (FloatType (atanC1) + z2 * (FloatType (atanC2)
+                       + z2 * (FloatType (atanC3) + z2 * (FloatType (atanC4) + z2 * FloatType (atanC5))))));
+            auto r = invert ? FloatType (halfPi) - p : p;
+            return std::copysign (r, x);
+        }
+
+        /** dryInOut = dryInOut * dryGain + wet * wetGain */
+        template <typename FloatType>
+        inline void mix (FloatType* dryInOut, const FloatType* wet, FloatType dryGain, FloatType wetGain, int numSamples) noexcept
+        {
+            for (int i = 0; i < numSamples; ++i)
+                dryInOut[i] = dryInOut[i] * dryGain + wet[i] * wetGain;
+        }
+
+        /** dest = 2/pi * atan (src * inputGain), the Distortion waveshaper */
+        template <typename FloatType>
+        inline void shapeAtan (FloatType* dest, const FloatType* src, FloatType inputGain, int numSamples) noexcept
+        {
+            for (int i = 0; i < numSamples; ++i)
+                dest[i] = FloatType (twoOverPi) * atan (src[i] * inputGain);
+        }
+
+        /** dest ~= 2/pi * atan (src * inputGain) without the polynomial, for QualityGovernor's reduced levels */
+        template <typename FloatType>
+        inline void shapeRational (FloatType* dest, const FloatType* src, FloatType inputGain, int numSamples) noexcept
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                auto x = src[i] * inputGain;
+                auto a = std::abs (x);
+                dest[i] = x * (FloatType (twoOverPi) + FloatType (rationalA) * a)
+                            / (FloatType (1) + a * (FloatType (rationalB) + FloatType (rationalA) * a));
+            }
+        }
+
+        /** svfLanes for lanes firstLane to lastLane - 1 only: the vector variants' leftovers. */
+        inline void svfLaneRange (SvfLanes& f, int firstLane, int lastLane, const float* input, float* output, float* scaled, int numSamples) noexcept
+        {
+            const int stride = f.numLanes;
+
+            for (int lane = firstLane; lane < lastLane; ++lane)
+            {
+                float ic1[SvfLanes::maxStages], ic2[SvfLanes::maxStages];
+
+                for (int s = 0; s < f.numStages; ++s)
+                {
+                    ic1[s] = f.ic1[s][lane];
+                    ic2[s] = f.ic2[s][lane];
+                }
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    auto x = input[i * stride + lane];
+
+                    for (int s = 0; s < f.numStages; ++s)
+                    {
+                        auto v3 = x - ic2[s];
+                        auto v1 = f.a1[s] * ic1[s] + f.a2[s] * v3;
+                        auto v2 = ic2[s] + f.a2[s] * ic1[s] + f.a3[s] * v3;
+                        ic1[s] = v1 + v1 - ic1[s];
+                        ic2[s] = v2 + v2 - ic2[s];
+                        auto highPass = x - f.k[s] * v1 - v2;
+                        x = f.low[s][lane] * v2 + f.band[s][lane] * v1 + f.high[s][lane] * highPass;
+                    }
+
+                    output[i * stride + lane] = x;
+                    scaled[i * stride + lane] = x * f.gain[lane];
+                }
+
+                for (int s = 0; s < f.numStages; ++s)
+                {
+                    f.ic1[s][lane] = ic1[s];
+                    f.ic2[s][lane] = ic2[s];
+                }
+            }
+        }
+
+        /** Runs numSamples interleaved samples through every lane of f: output = filtered, scaled = filtered * gain. */
+        inline void svfLanes (SvfLanes& f, const float* input, float* output, float* scaled, int numSamples) noexcept
+        {
+            svfLaneRange (f, 0, f.numLanes, input, output, scaled, numSamples);
+        }
+    }
+
+   #if JUCE_INTEL
+    namespace sse2
+    {
+        inline __m128 atan (__m128 x) noexcept
+        {
+            const auto signMask = _mm_set1_ps (-0.0f);
+            const auto one = _mm_set1_ps (1.0f);
+
+            auto sign = _mm_and_ps (x, signMask);
+            auto a = _mm_andnot_ps (signMask, x);
+            auto invert = _mm_cmpgt_ps (a, one);
+            auto z = _mm_or_ps (_mm_and_ps (invert, _mm_div_ps (one, a)), _mm_andnot_ps (invert, a));
+            auto z2 = _mm_mul_ps (z, z);
+
+            auto p = _mm_add_ps (_mm_set1_ps (atanC4), _mm_mul_ps (z2, _mm_set1_ps (atanC5)));
+            p = _mm_add_ps (_mm_set1_ps (atanC3), _mm_mul_ps (z2, p));
+            p = _mm_add_ps (_mm_set1_ps (atanC2), _mm_mul_ps (z2, p));
+            p = _mm_add_ps (_mm_set1_ps (atanC1), _mm_mul_ps (z2, p));
+            p = _mm_add_ps (_mm_set1_ps (atanC0), _mm_mul_ps (z2, p));
+            p = _mm_mul_ps (z, p);
+
+            auto r = _mm_or_ps (_mm_and_ps (invert, _mm_sub_ps (_mm_set1_ps (halfPi), p)), _mm_andnot_ps (invert, p));
+            return _mm_or_ps (r, sign);
+        }
+
+        inline void mix (float* dryInOut, const float* wet, float dryGain, float wetGain, int numSamples) noexcept
+        {
+            const auto d = _mm_set1_ps (dryGain);
+            const auto w = _mm_set1_ps (wetGain);
+            int i = 0;
+
+            for (; i + 4 <= numSamples; i += 4)
+                _mm_storeu_ps (dryInOut + i, _mm_add_ps (_mm_mul_ps (_mm_loadu_ps (dryInOut + i), d),
+                                                         _mm_mul_ps (_mm_loadu_ps (wet + i), w)));
+
+            scalar::mix (dryInOut + i, wet + i, dryGain, wetGain, numSamples - i);
+        }
+
+        inline void shapeAtan (float* dest, const float* src, float inputGain, int numSamples) noexcept
+        {
+            const auto g = _mm_set1_ps (inputGain);
+            const auto k = _mm_set1_ps (twoOverPi);
+            int i = 0;
+
+            for (; i + 4 <= numSamples; i += 4)
+                _mm_storeu_ps (dest + i, _mm_mul_ps (k, atan (_mm_mul_ps (_mm_loadu_ps (src + i), g))));
+
+            scalar::shapeAtan (dest + i, src + i, inputGain, numSamples - i);
+        }
+
+        inline void shapeRational (float* dest, const float* src, float inputGain, int numSamples) noexcept
+        {
+            const auto g = _mm_set1_ps (inputGain);
+            const auto k = _mm_set1_ps (twoOverPi);
+            const auto ra = _mm_set1_ps (rationalA);
+            const auto rb = _mm_set1_ps (rationalB);
+            const auto one = _mm_set1_ps (1.0f);
+            const auto signMask = _mm_set1_ps (-0.0f);
+            int i = 0;
+
+            for (; i + 4 <= numSamples; i += 4)
+            {
+                auto x = _mm_mul_ps (_mm_loadu_ps (src + i), g);
+                auto a = _mm_andnot_ps (signMask, x);
+                auto numerator = _mm_mul_ps (x, _mm_add_ps (k, _mm_mul_ps (ra, a)));
+                auto denominator = _mm_add_ps (one, _mm_mul_ps (a, _mm_add_ps (rb, _mm_mul_ps (ra, a))));
+                _mm_storeu_ps (dest + i, _mm_div_ps (numerator, denominator));
+            }
+
+            scalar::shapeRational (dest + i, src + i, inputGain, numSamples - i);
+        }
+
+        inline void svfLanes (SvfLanes& f, const float* input, float* output, float* scaled, int numSamples) noexcept
+        {
+            constexpr int maxStages = SvfLanes::maxStages;
+            const int stride = f.numLanes;
+            int lane = 0;
+
+            // the state stays in registers for the whole block
+            for (; lane + 4 <= f.numLanes; lane += 4)
+            {
+                __m128 a1[maxStages], a2[maxStages], a3[maxStages], k[maxStages];
+                __m128 low[maxStages], band[maxStages], high[maxStages], ic1[maxStages], ic2[maxStages];
+
+                for (int s = 0; s < f.numStages; ++s)
+                {
+                    a1[s] = _mm_set1_ps (f.a1[s]);
+                    a2[s] = _mm_set1_ps (f.a2[s]);
+                    a3[s] = _mm_set1_ps (f.a3[s]);
+                    k[s] = _mm_set1_ps (f.k[s]);
+                    low[s] = _mm_loadu_ps (f.low[s] + lane);
+                    band[s] = _mm_loadu_ps (f.band[s] + lane);
+                    high[s] = _mm_loadu_ps (f.high[s] + lane);
+                    ic1[s] = _mm_loadu_ps (f.ic1[s] + lane);
+                    ic2[s] = _mm_loadu_ps (f.ic2[s] + lane);
+                }
+
+                const auto gain = _mm_loadu_ps (f.gain + lane);
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    auto x = _mm_loadu_ps (input + i * stride + lane);
+
+                    for (int s = 0; s < f.numStages; ++s)
+                    {
+                        auto v3 = _mm_sub_ps (x, ic2[s]);
+                        auto v1 = _mm_add_ps (_mm_mul_ps (a1[s], ic1[s]), _mm_mul_ps (a2[s], v3));
+                        auto v2 = _mm_add_ps (_mm_add_ps (ic2[s], _mm_mul_ps (a2[s], ic1[s])), _mm_mul_ps (a3[s], v3));
+                        ic1[s] = _mm_sub_ps (_mm_add_ps (v1, v1), ic1[s]);
+                        ic2[s] = _mm_sub_ps (_mm_add_ps (v2, v2), ic2[s]);
+                        auto highPass = _mm_sub_ps (_mm_sub_ps (x, _mm_mul_ps (k[s], v1)), v2);
+                        x = _mm_add_ps (_mm_add_ps (_mm_mul_ps (low[s], v2), _mm_mul_ps (band[s], v1)),
+                                       _mm_mul_ps (high[s], highPass));
+                    }
+
+                    _mm_storeu_ps (output + i * stride + lane, x);
+                    _mm_storeu_ps (scaled + i * stride + lane, _mm_mul_ps (x, gain));
+                }
+
+                for (int s = 0; s < f.numStages; ++s)
+                {
+                    _mm_storeu_ps (f.ic1[s] + lane, ic1[s]);
+                    _mm_storeu_ps (f.ic2[s] + lane, ic2[s]);
+                }
+            }
+
+            scalar::svfLaneRange (f, lane, f.numLanes, input, output, scaled, numSamples);
+        }
+    }
+
+    namespace avx2
+    {
+        JUCE_PROJECTS_TARGET ("avx2")
+        inline __m256 atan (__m256 x) noexcept
+        {
+            const auto signMask = _mm256_set1_ps (-0.0f);
+            const auto one = _mm256_set1_ps (1.0f);
+
+            auto sign = _mm256_and_ps (x, signMask);
+            auto a = _mm256_andnot_ps (signMask, x);
+            auto invert = _mm256_cmp_ps (a, one, _CMP_GT_OQ);
+            auto z = _mm256_blendv_ps (a, _mm256_div_ps (one, a), invert);
+            auto z2 = _mm256_mul_ps (z, z);
+
+            auto p = _mm256_add_ps (_mm256_set1_ps (atanC4), _mm256_mul_ps (z2, _mm256_set1_ps (atanC5)));
+            p = _mm256_add_ps (_mm256_set1_ps (atanC3), _mm256_mul_ps (z2, p));
+            p = _mm256_add_ps (_mm256_set1_ps (atanC2), _mm256_mul_ps (z2, p));
+            p = _mm256_add_ps (_mm256_set1_ps (atanC1), _mm256_mul_ps (z2, p));
+            p = _mm256_add_ps (_mm256_set1_ps (atanC0), _mm256_mul_ps (z2, p));
+            p = _mm256_mul_ps (z, p);
+
+            auto r = _mm256_blendv_ps (p, _mm256_sub_ps (_mm256_set1_ps (halfPi), p), invert);
+            return _mm256_or_ps (r, sign);
+        }
+
+        JUCE_PROJECTS_TARGET ("avx2")
+        inline void mix (float* dryInOut, const float* wet, float dryGain, float wetGain, int numSamples) noexcept
+        {
+            const auto d = _mm256_set1_ps (dryGain);
+            const auto w = _mm256_set1_ps (wetGain);
+            int i = 0;
+
+            for (; i + 8 <= numSamples; i += 8)
+                _mm256_storeu_ps (dryInOut + i, _mm256_add_ps (_mm256_mul_ps (_mm256_loadu_ps (dryInOut + i), d),
+                                                               _mm256_mul_ps (_mm256_loadu_ps (wet + i), w)));
+
+            scalar::mix (dryInOut + i, wet + i, dryGain, wetGain, numSamples - i);
+        }
+
+        JUCE_PROJECTS_TARGET ("avx2")
+        inline void shapeAtan (float* dest, const float* src, float inputGain, int numSamples) noexcept
+        {
+            const auto g = _mm256_set1_ps (inputGain);
+            const auto k = _mm256_set1_ps (twoOverPi);
+            int i = 0;
+
+            for (; i + 8 <= numSamples; i += 8)
+                _mm256_storeu_ps (dest + i, _mm256_mul_ps (k, atan (_mm256_mul_ps (_mm256_loadu_ps (src + i), g))));
+
+            scalar::shapeAtan (dest + i, src + i, inputGain, numSamples - i);
+        }
+
+        JUCE_PROJECTS_TARGET ("avx2")
+        inline void shapeRational (float* dest, const float* src, float inputGain, int numSamples) noexcept
+        {
+            const auto g = _mm256_set1_ps (inputGain);
+            const auto k = _mm256_set1_ps (twoOverPi);
+            const auto ra = _mm256_set1_ps (rationalA);
+            const auto rb = _mm256_set1_ps (rationalB);
+            const auto one = _mm256_set1_ps (1.0f);
+            const auto signMask = _mm256_set1_ps (-0.0f);
+            int i = 0;
+
+            for (; i + 8 <= numSamples; i += 8)
+            {
+                auto x = _mm256_mul_ps (_mm256_loadu_ps (src + i), g);
+                auto a = _mm256_andnot_ps (signMask, x);
+                auto numerator = _mm256_mul_ps (x, _mm256_add_ps (k, _mm256_mul_ps (ra, a)));
+                auto denominator = _mm256_add_ps (one, _mm256_mul_ps (a, _mm256_add_ps (rb, _mm256_mul_ps (ra, a))));
+                _mm256_storeu_ps (dest + i, _mm256_div_ps (numerator, denominator));
+            }
+
+            scalar::shapeRational (dest + i, src + i, inputGain, numSamples - i);
+        }
+
+        JUCE_PROJECTS_TARGET ("avx2")
+        inline void svfLanes (SvfLanes& f, const float* input, float* output, float* scaled, int numSamples) noexcept
+        {
+            constexpr int maxStages = SvfLanes::maxStages;
+            const int stride = f.numLanes;
+            int lane = 0;
+
+            // the state stays in registers for the whole block
+            for (; lane + 8 <= f.numLanes; lane += 8)
+            {
+                __m256 a1[maxStages], a2[maxStages], a3[maxStages], k[maxStages];
+                __m256 low[maxStages], band[maxStages], high[maxStages], ic1[maxStages], ic2[maxStages];
+
+                for (int s = 0; s < f.numStages; ++s)
+                {
+                    a1[s] = _mm256_set1_ps (f.a1[s]);
+                    a2[s] = _mm256_set1_ps (f.a2[s]);
+                    a3[s] = _mm256_set1_ps (f.a3[s]);
+                    k[s] = _mm256_set1_ps (f.k[s]);
+                    low[s] = _mm256_loadu_ps (f.low[s] + lane);
+                    band[s] = _mm256_loadu_ps (f.band[s] + lane);
+                    high[s] = _mm256_loadu_ps (f.high[s] + lane);
+                    ic1[s] = _mm256_loadu_ps (f.ic1[s] + lane);
+                    ic2[s] = _mm256_loadu_ps (f.ic2[s] + lane);
+                }
+
+                const auto gain = _mm256_loadu_ps (f.gain + lane);
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    auto x = _mm256_loadu_ps (input + i * stride + lane);
+
+                    for (int s = 0; s < f.numStages; ++s)
+                    {
+                        auto v3 = _mm256_sub_ps (x, ic2[s]);
+                        auto v1 = _mm256_add_ps (_mm256_mul_ps (a1[s], ic1[s]), _mm256_mul_ps (a2[s], v3));
+                        auto v2 = _mm256_add_ps (_mm256_add_ps (ic2[s], _mm256_mul_ps (a2[s], ic1[s])), _mm256_mul_ps (a3[s], v3));
+                        ic1[s] = _mm256_sub_ps (_mm256_add_ps (v1, v1), ic1[s]);
+                        ic2[s] = _mm256_sub_ps (_mm256_add_ps (v2, v2), ic2[s]);
+                        auto highPass = _mm256_sub_ps (_mm256_sub_ps (x, _mm256_mul_ps (k[s], v1)), v2);
+                        x = _mm256_add_ps (_mm256_add_ps (_mm256_mul_ps (low[s], v2), _mm256_mul_ps (band[s], v1)),
+                                       _mm256_mul_ps (high[s], highPass));
+                    }
+
+                    _mm256_storeu_ps (output + i * stride + lane, x);
+                    _mm256_storeu_ps (scaled + i * stride + lane, _mm256_mul_ps (x, gain));
+                }
+
+                for (int s = 0; s < f.numStages; ++s)
+                {
+                    _mm256_storeu_ps (f.ic1[s] + lane, ic1[s]);
+                    _mm256_storeu_ps (f.ic2[s] + lane, ic2[s]);
+                }
+            }
+
+            scalar::svfLaneRange (f, lane, f.numLanes, input, output, scaled, numSamples);
+        }
+    }
+
+    namespace avx512
+    {
+        JUCE_PROJECTS_TARGET ("avx512f")
+        inline __m512 atan (__m512 x) noexcept
+        {
+            const auto one = _mm512_set1_ps (1.0f);
+            const auto signBits = _mm512_set1_epi32 ((int) 0x80000000u);
+
+            auto sign = _mm512_and_si512 (_mm512_castps_si512 (x), signBits);
+            auto a = _mm512_castsi512_ps (_mm512_andnot_si512 (signBits, _mm512_castps_si512 (x)));
+            auto invert = _mm512_cmp_ps_mask (a, one, _CMP_GT_OQ);
+            auto z = _mm512_mask_div_ps (a, invert, one, a);
+            auto z2 = _mm512_mul_ps (z, z);
+
+            auto p = _mm512_add_ps (_mm512_set1_ps (atanC4), _mm512_mul_ps (z2, _mm512_set1_ps (atanC5)));
+            p = _mm512_add_ps (_mm512_set1_ps (atanC3), _mm512_mul_ps (z2, p));
+            p = _mm512_add_ps (_mm512_set1_ps (atanC2), _mm512_mul_ps (z2, p));
+            p = _mm512_add_ps (_mm512_set1_ps (atanC1), _mm512_mul_ps (z2, p));
+            p = _mm512_add_ps (_mm512_set1_ps (atanC0), _mm512_mul_ps (z2, p));
+            p = _mm512_mul_ps (z, p);
+
+            auto r = _mm512_mask_sub_ps (p, invert, _mm512_set1_ps (halfPi), p);
+            return _mm512_castsi512_ps (_mm512_or_si512 (_mm512_castps_si512 (r), sign));
+        }
+
+        JUCE_PROJECTS_TARGET ("avx512f")
+        inline void mix (float* dryInOut, const float* wet, float dryGain, float wetGain, int numSamples) noexcept
+        {
+            const auto d = _mm512_set1_ps (dryGain);
+            const auto w = _mm512_set1_ps (wetGain);
+            int i = 0;
+
+            for (; i + 16 <= numSamples; i += 16)
+                _mm512_storeu_ps (dryInOut + i, _mm512_add_ps (_mm512_mul_ps (_mm512_loadu_ps (dryInOut + i), d),
+                                                               _mm512_mul_ps (_mm512_loadu_ps (wet + i), w)));
+
+            scalar::mix (dryInOut + i, wet + i, dryGain, wetGain, numSamples - i);
+        }
+
+        JUCE_PROJECTS_TARGET ("avx512f")
+        inline void shapeAtan (float* dest, const float* src, float inputGain, int numSamples) noexcept
+        {
+            const auto g = _mm512_set1_ps (inputGain);
+            const auto k = _mm512_set1_ps (twoOverPi);
+            int i = 0;
+
+            for (; i + 16 <= numSamples; i += 16)
+                _mm512_storeu_ps (dest + i, _mm512_mul_ps (k, atan (_mm512_mul_ps (_mm512_loadu_ps (src + i), g))));
+
+            scalar::shapeAtan (dest + i, src + i, inputGain, numSamples - i);
+        }
+
+        JUCE_PROJECTS_TARGET ("avx512f")
+        inline void shapeRational (float* dest, const float* src, float inputGain, int numSamples) noexcept
+        {
+            const auto g = _mm512_set1_ps (inputGain);
+            const auto k = _mm512_set1_ps (twoOverPi);
+            const auto ra = _mm512_set1_ps (rationalA);
+            const auto rb = _mm512_set1_ps (rationalB);
+            const auto one = _mm512_set1_ps (1.0f);
+            const auto signBits = _mm512_set1_epi32 ((int) 0x80000000u);
+            int i = 0;
+
+            for (; i + 16 <= numSamples; i += 16)
+            {
+                auto x = _mm512_mul_ps (_mm512_loadu_ps (src + i), g);
+                auto a = _mm512_castsi512_ps (_mm512_andnot_si512 (signBits, _mm512_castps_si512 (x)));
+                auto numerator = _mm512_mul_ps (x, _mm512_add_ps (k, _mm512_mul_ps (ra, a)));
+                auto denominator = _mm512_add_ps (one, _mm512_mul_ps (a, _mm512_add_ps (rb, _mm512_mul_ps (ra, a))));
+                _mm512_storeu_ps (dest + i, _mm512_div_ps (numerator, denominator));
+            }
+
+            scalar::shapeRational (dest + i, src + i, inputGain, numSamples - i);
+        }
+
+        JUCE_PROJECTS_TARGET ("avx512f")
+        inline void svfLanes (SvfLanes& f, const float* input, float* output, float* scaled, int numSamples) noexcept
+        {
+            constexpr int maxStages = SvfLanes::maxStages;
+            const int stride = f.numLanes;
+            int lane = 0;
+
+            // the state stays in registers for the whole block
+            for (; lane + 16 <= f.numLanes; lane += 16)
+            {
+                __m512 a1[maxStages], a2[maxStages], a3[maxStages], k[maxStages];
+                __m512 low[maxStages], band[maxStages], high[maxStages], ic1[maxStages], ic2[maxStages];
+
+                for (int s = 0; s < f.numStages; ++s)
+                {
+                    a1[s] = _mm512_set1_ps (f.a1[s]);
+                    a2[s] = _mm512_set1_ps (f.a2[s]);
+                    a3[s] = _mm512_set1_ps (f.a3[s]);
+                    k[s] = _mm512_set1_ps (f.k[s]);
+                    low[s] = _mm512_loadu_ps (f.low[s] + lane);
+                    band[s] = _mm512_loadu_ps (f.band[s] + lane);
+                    high[s] = _mm512_loadu_ps (f.high[s] + lane);
+                    ic1[s] = _mm512_loadu_ps (f.ic1[s] + lane);
+                    ic2[s] = _mm512_loadu_ps (f.ic2[s] + lane);
+                }
+
+                const auto gain = _mm512_loadu_ps (f.gain + lane);
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    auto x = _mm512_loadu_ps (input + i * stride + lane);
+
+                    for (int s = 0; s < f.numStages; ++s)
+                    {
+                        auto v3 = _mm512_sub_ps (x, ic2[s]);
+                        auto v1 = _mm512_add_ps (_mm512_mul_ps (a1[s], ic1[s]), _mm512_mul_ps (a2[s], v3));
+                        auto v2 = _mm512_add_ps (_mm512_add_ps (ic2[s], _mm512_mul_ps (a2[s], ic1[s])), _mm512_mul_ps (a3[s], v3));
+                        ic1[s] = _mm512_sub_ps (_mm512_add_ps (v1, v1), ic1[s]);
+                        ic2[s] = _mm512_sub_ps (_mm512_add_ps (v2, v2), ic2[s]);
+                        auto highPass = _mm512_sub_ps (_mm512_sub_ps (x, _mm512_mul_ps (k[s], v1)), v2);
+                        x = _mm512_add_ps (_mm512_add_ps (_mm512_mul_ps (low[s], v2), _mm512_mul_ps (band[s], v1)),
+                                       _mm512_mul_ps (high[s], highPass));
+                    }
+
+                    _mm512_storeu_ps (output + i * stride + lane, x);
+                    _mm512_storeu_ps (scaled + i * stride + lane, _mm512_mul_ps (x, gain));
+                }
+
+                for (int s = 0; s < f.numStages; ++s)
+                {
+                    _mm512_storeu_ps (f.ic1[s] + lane, ic1[s]);
+                    _mm512_storeu_ps (f.ic2[s] + lane, ic2[s]);
+                }
+            }
+
+            scalar::svfLaneRange (f, lane, f.numLanes, input, output, scaled, numSamples);
+        }
+    }
+   #endif
+}
+
+#if JUCE_GCC
+ #pragma GCC pop_options
+#elif JUCE_CLANG
+ #pragma float_control (pop)
+#endif
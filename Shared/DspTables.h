@@ -0,0 +1,193 @@
+/*
+  ==============================================================================
+
+    DspTables.h
+
+    Read-only lookup tables (LFO wavetables, interpolation weights, ...)
+    shared by every plugin instance in the process. Hold a
+    juce::SharedResourcePointer<DspTables> and ask it for a table by shape
+    and size: the first request builds it, every later one, from any
+    instance, gets the same memory back. Tables are never changed or freed
+    while the registry lives, so instances keep plain pointers into them.
+
+    get() takes a lock and may build, so call it off the audio thread (in a
+    constructor or prepareToPlay) and keep the result.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+class DspTables
+{
+public:
+    enum class Shape
+    {
+        sine,               // one cycle of sin (2 pi x), size points plus a wrap point
+        hermiteWeights,     // Catmull-Rom weights for 4 taps, size + 1 fractional positions
+        windowedSinc8,      // Blackman-windowed sinc weights for 8 taps, likewise
+        windowedSinc16,     // and for 16 taps
+        hannWindow          // periodic Hann window of size points, for FFT analysis
+    };
+
+    static constexpr size_t alignment = 64;
+
+    //==============================================================================
+    /** numRows rows of getRowLength() floats, back to back, starting on a cache line. */
+    class Table
+    {
+    public:
+        Table (int size, int numRows, int rowLength)
+            : mSize (size), mNumRows (numRows), mRowLength (rowLength),
+              mData (static_cast<float*> (::operator new (sizeof (float) * (size_t) (numRows * rowLength), std::align_val_t (alignment))))
+        {
+        }
+
+        int getSize() const noexcept                 { return mSize; }
+        int getNumRows() const noexcept              { return mNumRows; }
+        int getRowLength() const noexcept            { return mRowLength; }
+
+        const float* getRow (int row) const noexcept { return mData.get() + row * mRowLength; }
+        float* getRow (int row) noexcept             { return mData.get() + row * mRowLength; }
+
+    private:
+        struct AlignedDelete
+        {
+            void operator() (float* data) const noexcept  { ::operator delete (data, std::align_val_t (alignment)); }
+        };
+
+        int mSize, mNumRows, mRowLength;
+        std::unique_ptr<float, AlignedDelete> mData;
+
+        JUCE_DECLARE_NON_COPYABLE (Table)
+    };
+
+    //==============================================================================
+    DspTables() = default;
+
+    /** The table for this shape and size, built on first request. */
+    const Table& get (Shape shape, int size)
+    {
+        jassert (size > 0);
+
+        const std::lock_guard<std::mutex> lock (mLock);
+
+        auto& table = mTables[{ shape, size }];
+
+        if (table == nullptr)
+            table = build (shape, size);
+
+        return *table;
+    }
+
+    /** Bytes held by all the tables built so far. */
+    size_t getMemoryUsage() const
+    {
+        const std::lock_guard<std::mutex> lock (mLock);
+        size_t bytes = 0;
+
+        for (auto& keyAndTable : mTables)
+            bytes += sizeof (float) * (size_t) (keyAndTable.second->getNumRows() * keyAndTable.second->getRowLength());
+
+        return bytes;
+    }
+
+private:
+    static std::unique_ptr<Table> build (Shape shape, int size)
+    {
+        switch (shape)
+        {
+            case Shape::hermiteWeights:  return buildHermite (size);
+            case Shape::windowedSinc8:   return buildWindowedSinc (size, 8);
+            case Shape::windowedSinc16:  return buildWindowedSinc (size, 16);
+            case Shape::hannWindow:      return buildHann (size);
+            case Shape::sine:            break;
+        }
+
+        return buildSine (size);
+    }
+
+    static std::unique_ptr<Table> buildSine (int size)
+    {
+        auto t = std::make_unique<Table> (size, size + 1, 1);
+
+        for (int i = 0; i <= size; ++i)
+            *t->getRow (i) = (float) std::sin (juce::MathConstants<double>::twoPi * i / size);
+
+        return t;
+    }
+
+    static std::unique_ptr<Table> buildHann (int size)
+    {
+        auto t = std::make_unique<Table> (size, size, 1);
+
+        for (int i = 0; i < size; ++i)
+            *t->getRow (i) = (float) (0.5 - 0.5 * std::cos (juce::MathConstants<double>::twoPi * i / size));
+
+        return t;
+    }
+
+    /** Catmull-Rom spline through samples index - 1 ... index + 2. */
+    static std::unique_ptr<Table> buildHermite (int size)
+    {
+        auto t = std::make_unique<Table> (size, size + 1, 4);
+
+        for (int phase = 0; phase <= size; ++phase)
+        {
+            const auto f = (double) phase / size;
+            const auto f2 = f * f;
+            const auto f3 = f2 * f;
+            auto* row = t->getRow (phase);
+
+            row[0] = (float) (-0.5 * f + f2 - 0.5 * f3);
+            row[1] = (float) (1.0 - 2.5 * f2 + 1.5 * f3);
+            row[2] = (float) (0.5 * f + 2.0 * f2 - 1.5 * f3);
+            row[3] = (float) (-0.5 * f2 + 0.5 * f3);
+        }
+
+        return t;
+    }
+
+    /** Taps index - (numTaps / 2 - 1) ... index + numTaps / 2, each row normalised to unity gain at DC. */
+    static std::unique_ptr<Table> buildWindowedSinc (int size, int numTaps)
+    {
+        auto t = std::make_unique<Table> (size, size + 1, numTaps);
+        const auto halfWidth = numTaps / 2.0;
+
+        for (int phase = 0; phase <= size; ++phase)
+        {
+            const auto f = (double) phase / size;
+            auto* row = t->getRow (phase);
+            double sum = 0.0;
+
+            for (int tap = 0; tap < numTaps; ++tap)
+            {
+                // distance of this tap from the read position
+                const auto x = (tap - (numTaps / 2 - 1)) - f;
+                const auto sinc = std::abs (x) < 1.0e-9 ? 1.0 : std::sin (juce::MathConstants<double>::pi * x) / (juce::MathConstants<double>::pi * x);
+                const auto w = juce::MathConstants<double>::pi * x / halfWidth;
+                const auto window = std::abs (x) >= halfWidth ? 0.0 : 0.42 + 0.5 * std::cos (w) + 0.08 * std::cos (2.0 * w);
+
+                row[tap] = (float) (sinc * window);
+                sum += sinc * window;
+            }
+
+            for (int tap = 0; tap < numTaps; ++tap)
+                row[tap] = (float) ((double) row[tap] / sum);
+        }
+
+        return t;
+    }
+
+    mutable std::mutex mLock;
+    std::map<std::pair<Shape, int>, std::unique_ptr<Table>> mTables;
+
+    JUCE_DECLARE_NON_COPYABLE (DspTables)
+};
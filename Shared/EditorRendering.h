@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+    EditorRendering.h
+
+    Keeps editor repaints cheap enough for a screen full of plugin windows.
+
+    CachedLayer holds the parts of a component that only change with its
+    size, like the background and labels, painted once into an image at
+    the display's pixel scale. After that a repaint is a blit of the dirty
+    region. There's one image per scale factor, so a window moved between
+    a retina and a standard display doesn't re-render on every paint.
+    Nothing is rendered in resized(): the layer notices the new size at
+    the next paint, however many resizes came in between.
+
+    Editors lay themselves out at a fixed design size. DesignScale maps
+    those coordinates onto the editor's actual size, and makeResizable
+    lets the host resize it, keeping the aspect ratio.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <utility>
+#include <vector>
+
+namespace EditorRendering
+{
+    class CachedLayer
+    {
+    public:
+        /** Blits the layer over bounds, first painting it with paintLayer
+            (given a Graphics in bounds' coordinates, origin at its top left)
+            if there's no image for this size and pixel scale yet.
+        */
+        template <typename PaintLayer>
+        void draw (juce::Graphics& g, juce::Rectangle<int> bounds, PaintLayer&& paintLayer)
+        {
+            if (bounds.isEmpty())
+                return;
+
+            if (bounds.getWidth() != mWidth || bounds.getHeight() != mHeight)
+            {
+                mImages.clear();
+                mWidth = bounds.getWidth();
+                mHeight = bounds.getHeight();
+            }
+
+            const auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+            const juce::Image* image = nullptr;
+
+            for (auto& scaleAndImage : mImages)
+                if (scaleAndImage.first == scale)
+                    image = &scaleAndImage.second;
+
+            if (image == nullptr)
+            {
+                // a window only ever spans a couple of displays
+                if (mImages.size() >= maxScales)
+                    mImages.erase (mImages.begin());
+
+                juce::Image rendered (juce::Image::RGB,
+                                      juce::jmax (1, juce::roundToInt ((float) mWidth * scale)),
+                                      juce::jmax (1, juce::roundToInt ((float) mHeight * scale)),
+                                      false);
+                {
+                    juce::Graphics layer (rendered);
+                    layer.addTransform (juce::AffineTransform::scale (scale));
+                    paintLayer (layer);
+                }
+
+                mImages.emplace_back (scale, rendered);
+                image = &mImages.back().second;
+            }
+
+            g.drawImage (*image, bounds.toFloat());
+        }
+
+        /** For content that changes without a resize. */
+        void invalidate()  { mImages.clear(); }
+
+    private:
+        static constexpr size_t maxScales = 2;
+
+        std::vector<std::pair<float, juce::Image>> mImages;
+        int mWidth = 0;
+        int mHeight = 0;
+    };
+
+    //==============================================================================
+    /** Scales layout coordinates written for designWidth onto component's current width. */
+    struct DesignScale
+    {
+        DesignScale (const juce::Component& component, int designWidth) noexcept
+            : scale ((float) component.getWidth() / (float) designWidth)
+        {
+        }
+
+        juce::Rectangle<int> operator() (int x, int y, int width, int height) const noexcept
+        {
+            return juce::Rectangle<int> (x, y, width, height).toFloat().transformedBy (getTransform()).toNearestInt();
+        }
+
+        juce::AffineTransform getTransform() const noexcept  { return juce::AffineTransform::scale (scale); }
+
+        float scale;
+    };
+
+    /** Call after setSize with the design size: the host may then resize
+        the editor from half to twice that, at the same aspect ratio.
+    */
+    inline void makeResizable (juce::AudioProcessorEditor& editor)
+    {
+        const int width = editor.getWidth();
+        const int height = editor.getHeight();
+
+        editor.setResizable (true, true);
+        editor.setResizeLimits (width / 2, height / 2, width * 2, height * 2);
+
+        if (auto* constrainer = editor.getConstrainer())
+            constrainer->setFixedAspectRatio ((double) width / (double) height);
+    }
+}
@@ -0,0 +1,144 @@
+/*
+  ==============================================================================
+
+    FixedBlockScheduler.h
+
+    An opt-in throughput mode: host blocks of any size go through a FIFO,
+    and the DSP only ever runs on whole blocks of a fixed power-of-two
+    size. Hosts that call with 16, 32 or odd-sized blocks then pay the
+    per-block overhead (parameter reads, pointer setup, chunk loops) once
+    per fixed block instead of once per call, and the vector kernels get
+    full-width runs without a scalar tail.
+
+    It costs exactly one fixed block of latency, which the processor
+    reports with setLatencySamples. The default is off: processBlock runs
+    straight on the host's buffer with no added latency.
+
+    Each processor turns it on with setFixedBlockSize (see
+    ProcessorOptions.h; 64 or 128 suit mixing sessions), or every
+    instance in the process with the JUCE_PROJECTS_FIXED_BLOCK_SIZE
+    environment variable, before prepareToPlay.
+
+    process() takes float or double buffers, whichever the host uses.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <tuple>
+
+class FixedBlockScheduler
+{
+public:
+    static constexpr int minBlockSize = 16;
+    static constexpr int maxBlockSize = 1024;
+
+    FixedBlockScheduler()
+    {
+        setBlockSize (juce::SystemStats::getEnvironmentVariable ("JUCE_PROJECTS_FIXED_BLOCK_SIZE", {}).getIntValue());
+    }
+
+    /** 0 (off), or a power of two from minBlockSize to maxBlockSize. */
+    static bool isValidBlockSize (int blockSize) noexcept
+    {
+        return blockSize == 0
+            || (juce::isPowerOfTwo (blockSize) && blockSize >= minBlockSize && blockSize <= maxBlockSize);
+    }
+
+    /** 0 turns the mode off. Otherwise see isValidBlockSize. Takes effect at
+        the next prepare.
+    */
+    void setBlockSize (int blockSize)
+    {
+        const bool isValid = isValidBlockSize (blockSize);
+        jassert (isValid);
+
+        mRequestedBlockSize = isValid ? blockSize : 0;
+    }
+
+    int getRequestedBlockSize() const noexcept  { return mRequestedBlockSize; }
+
+    /** From prepareToPlay. Returns the largest block the DSP will be handed:
+        the fixed size if the mode is on, otherwise hostBlockSize.
+    */
+    int prepare (int numChannels, int hostBlockSize)
+    {
+        mBlockSize = mRequestedBlockSize;
+        mPosition = 0;
+
+        resetBlocks (std::get<Blocks<float>> (mBlocks), numChannels);
+        resetBlocks (std::get<Blocks<double>> (mBlocks), numChannels);
+
+        return isEnabled() ? mBlockSize : hostBlockSize;
+    }
+
+    bool isEnabled() const noexcept         { return mBlockSize > 0; }
+    int getLatencySamples() const noexcept  { return mBlockSize; }
+
+    /** Runs process on the host's buffer directly, or, in fixed block mode,
+        on every fixed block completed by buffer's samples, delaying buffer
+        by one fixed block.
+    */
+    template <typename FloatType, typename Process>
+    void process (juce::AudioBuffer<FloatType>& buffer, Process&& process)
+    {
+        if (! isEnabled())
+        {
+            process (buffer);
+            return;
+        }
+
+        auto& blocks = std::get<Blocks<FloatType>> (mBlocks);
+        const int numChannels = juce::jmin (buffer.getNumChannels(), blocks[0].getNumChannels());
+        const int numSamples = buffer.getNumSamples();
+
+        for (int done = 0; done < numSamples;)
+        {
+            const int span = juce::jmin (mBlockSize - mPosition, numSamples - done);
+            auto& input = blocks[(size_t) mInput];
+            auto& output = blocks[(size_t) (1 - mInput)];
+
+            // the input goes in, the block processed one block ago comes out
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                input.copyFrom (channel, mPosition, buffer, channel, done, span);
+                buffer.copyFrom (channel, done, output, channel, mPosition, span);
+            }
+
+            mPosition += span;
+            done += span;
+
+            if (mPosition == mBlockSize)
+            {
+                process (input);
+
+                // processed in place, it's the next block to play out
+                mInput = 1 - mInput;
+                mPosition = 0;
+            }
+        }
+    }
+
+private:
+    template <typename FloatType>
+    using Blocks = std::array<juce::AudioBuffer<FloatType>, 2>;
+
+    template <typename FloatType>
+    void resetBlocks (Blocks<FloatType>& blocks, int numChannels)
+    {
+        for (auto& block : blocks)
+        {
+            block.setSize (numChannels, mBlockSize);
+            block.clear();
+        }
+    }
+
+    std::tuple<Blocks<float>, Blocks<double>> mBlocks;
+    int mInput = 0;
+    int mPosition = 0;
+    int mBlockSize = 0;
+    int mRequestedBlockSize = 0;
+};
@@ -0,0 +1,227 @@
+/*
+  ==============================================================================
+
+    LinkwitzRiley.h
+
+    Splits every channel into 2 to 4 bands with 4th order Linkwitz-Riley
+    crossovers. The bands add back up to the input with a flat magnitude:
+    below each crossover a band picks up that crossover's allpass, so all
+    bands share one phase response.
+
+    Each band of each channel is one lane of DspKernels::SvfLanes. A lane
+    runs a pair of Butterworth stages (k = sqrt 2) per crossover: high pass
+    for the crossovers below its band, low pass for the one above it, and
+    for the ones further up the allpass, then a passthrough that keeps the
+    lanes in step. Every lane then runs the same stages with the same
+    coefficients, so one svfLanes call advances every filter of every
+    channel, 8 or 16 lanes to a vector.
+
+    The same pass also writes each lane scaled by its band's drive, ready
+    to be shaped in place, again in one call for all bands and channels.
+
+    Work is interleaved, lanes fastest: lane = channel * numBands + band.
+    Double precision input is split in float.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "CpuDispatch.h"
+
+class LinkwitzRileyBands
+{
+public:
+    static constexpr int maxBands = 4;
+    static constexpr int maxChannels = DspKernels::SvfLanes::maxLanes / maxBands;
+
+    static constexpr float minFrequency = 20.0f;
+
+    /** From prepareToPlay. Allocates for maxBands bands of numChannels channels. */
+    void prepare (double sampleRate, int numChannels, int maxBlockSize)
+    {
+        jassert (numChannels <= maxChannels);
+
+        mSampleRate = sampleRate;
+        mNumChannels = juce::jlimit (1, maxChannels, numChannels);
+        mMaxBlockSize = juce::jmax (1, maxBlockSize);
+
+        // input, bands, driven bands
+        mInterleaved.setSize (3, mMaxBlockSize * mNumChannels * maxBands);
+
+        for (auto& frequency : mFrequencies)
+            frequency = 0.0f;
+
+        configure (mNumBands);
+    }
+
+    /** 2 to maxBands. A change clears the filters. */
+    void setNumBands (int numBands) noexcept
+    {
+        numBands = juce::jlimit (2, maxBands, numBands);
+
+        if (numBands != mNumBands)
+            configure (numBands);
+    }
+
+    int getNumBands() const noexcept       { return mNumBands; }
+    int getNumLanes() const noexcept       { return mFilters.numLanes; }
+    int getMaxBlockSize() const noexcept   { return mMaxBlockSize; }
+
+    /** The numBands - 1 crossover frequencies in Hz, lowest first. Out of
+        order ones are pushed up to the one below, and none goes past 0.45 fs.
+    */
+    void setCrossovers (const float* frequencies) noexcept
+    {
+        const auto maxFrequency = (float) (mSampleRate * 0.45);
+        float floor = minFrequency;
+
+        for (int crossover = 0; crossover < mNumBands - 1; ++crossover)
+        {
+            const auto frequency = juce::jlimit (floor, maxFrequency, frequencies[crossover]);
+            floor = frequency;
+
+            if (frequency == mFrequencies[crossover])
+                continue;
+
+            mFrequencies[crossover] = frequency;
+
+            const auto g = std::tan (juce::MathConstants<double>::pi * (double) frequency / mSampleRate);
+            const auto a1 = 1.0 / (1.0 + g * (g + butterworthK));
+
+            for (int stage = 2 * crossover; stage < 2 * crossover + 2; ++stage)
+            {
+                mFilters.a1[stage] = (float) a1;
+                mFilters.a2[stage] = (float) (g * a1);
+                mFilters.a3[stage] = (float) (g * g * a1);
+            }
+        }
+    }
+
+    /** The gain applied to band's driven copy, in every channel. */
+    void setDrive (int band, float gain) noexcept
+    {
+        for (int channel = 0; channel < mNumChannels; ++channel)
+            mFilters.gain[channel * mNumBands + band] = gain;
+    }
+
+    /** Splits numSamples (at most the prepared block size) of the first
+        numChannels channels into the band and driven band buffers.
+    */
+    template <typename FloatType>
+    void split (const CpuDispatch::Kernels& kernels, const FloatType* const* channels, int numSamples) noexcept
+    {
+        jassert (numSamples <= mMaxBlockSize);
+
+        auto* input = mInterleaved.getWritePointer (inputChannel);
+        const int numLanes = getNumLanes();
+
+        // every band of a channel starts from the same input
+        for (int channel = 0; channel < mNumChannels; ++channel)
+            for (int i = 0; i < numSamples; ++i)
+                for (int band = 0; band < mNumBands; ++band)
+                    input[i * numLanes + channel * mNumBands + band] = (float) channels[channel][i];
+
+        kernels.svfLanes (mFilters, input, getBands(), getDrivenBands(), numSamples);
+    }
+
+    /** channels = sum over bands of band * dryGains[band] + driven band * wetGains[band]. */
+    template <typename FloatType>
+    void combine (FloatType* const* channels, int numSamples, const float* dryGains, const float* wetGains) const noexcept
+    {
+        const auto* bands = mInterleaved.getReadPointer (bandsChannel);
+        const auto* driven = mInterleaved.getReadPointer (drivenChannel);
+        const int numLanes = getNumLanes();
+
+        for (int channel = 0; channel < mNumChannels; ++channel)
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const int first = i * numLanes + channel * mNumBands;
+                float sum = 0.0f;
+
+                for (int band = 0; band < mNumBands; ++band)
+                    sum += bands[first + band] * dryGains[band] + driven[first + band] * wetGains[band];
+
+                channels[channel][i] = (FloatType) sum;
+            }
+        }
+    }
+
+    /** Interleaved, getNumLanes() values per sample. */
+    float* getBands() noexcept           { return mInterleaved.getWritePointer (bandsChannel); }
+    float* getDrivenBands() noexcept     { return mInterleaved.getWritePointer (drivenChannel); }
+
+private:
+    static constexpr double butterworthK = 1.4142135623730951;
+
+    enum InterleavedChannel
+    {
+        inputChannel,
+        bandsChannel,
+        drivenChannel
+    };
+
+    void configure (int numBands) noexcept
+    {
+        mNumBands = numBands;
+        mFilters = {};
+        mFilters.numLanes = mNumChannels * numBands;
+        mFilters.numStages = 2 * (numBands - 1);
+
+        for (int stage = 0; stage < mFilters.numStages; ++stage)
+            mFilters.k[stage] = (float) butterworthK;
+
+        for (int channel = 0; channel < mNumChannels; ++channel)
+        {
+            for (int band = 0; band < numBands; ++band)
+            {
+                const int lane = channel * numBands + band;
+
+                for (int crossover = 0; crossover < numBands - 1; ++crossover)
+                {
+                    const int stage = 2 * crossover;
+
+                    if (crossover < band)
+                        setStages (stage, lane, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f);     // high pass
+                    else if (crossover == band)
+                        setStages (stage, lane, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);     // low pass
+                    else
+                        setStages (stage, lane, 1.0f, -(float) butterworthK, 1.0f,      // allpass
+                                                1.0f, (float) butterworthK, 1.0f);      // passthrough
+                }
+
+                mFilters.gain[lane] = 1.0f;
+            }
+        }
+
+        // the coefficients went with the rest
+        for (auto& frequency : mFrequencies)
+            frequency = 0.0f;
+
+        const float defaults[maxBands - 1] = { 200.0f, 1000.0f, 5000.0f };
+        setCrossovers (defaults);
+    }
+
+    /** The low, band and high pass weights of lane in the stage pair from stage. */
+    void setStages (int stage, int lane, float low1, float band1, float high1, float low2, float band2, float high2) noexcept
+    {
+        mFilters.low[stage][lane] = low1;
+        mFilters.band[stage][lane] = band1;
+        mFilters.high[stage][lane] = high1;
+        mFilters.low[stage + 1][lane] = low2;
+        mFilters.band[stage + 1][lane] = band2;
+        mFilters.high[stage + 1][lane] = high2;
+    }
+
+    DspKernels::SvfLanes mFilters;
+    float mFrequencies[maxBands - 1] {};
+
+    double mSampleRate = 44100.0;
+    int mNumChannels = 1;
+    int mNumBands = 2;
+    int mMaxBlockSize = 0;
+
+    juce::AudioBuffer<float> mInterleaved;
+};
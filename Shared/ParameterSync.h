@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+    ParameterSync.h
+
+    Keeps an editor's controls in step with its processor's parameters,
+    whoever changes them: host automation, preset morphs or state loads.
+
+    One listener covers every parameter. A change, on any thread, sets the
+    parameter's bit in an atomic dirty bitmask and does nothing else. Once
+    per display frame the editor swaps the bitmask for zero and updates
+    only the controls whose bits were set. UI work scales with the number
+    of changes, not with parameters times open editors, and a parameter
+    that changes many times between frames costs its control one update.
+
+    Create one per editor, after the controls it binds (so it goes first),
+    and bind each control once.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class ParameterSync  : private juce::AudioProcessorParameter::Listener
+{
+public:
+    ParameterSync (juce::AudioProcessor& processor, juce::Component& editor)
+        : mParameters (processor.getParameters()),
+          mNumWords ((size_t) (mParameters.size() + bitsPerWord - 1) / bitsPerWord),
+          mDirty (std::make_unique<std::atomic<juce::uint32>[]> (mNumWords)),
+          mUpdaters ((size_t) mParameters.size()),
+          mVBlank (&editor, [this] { update(); })
+    {
+        for (size_t word = 0; word < mNumWords; ++word)
+            mDirty[word].store (0, std::memory_order_relaxed);
+
+        for (auto* parameter : mParameters)
+            parameter->addListener (this);
+    }
+
+    ~ParameterSync() override
+    {
+        for (auto* parameter : mParameters)
+            parameter->removeListener (this);
+    }
+
+    //==============================================================================
+    /** Calls updateControl on the message thread after parameter has changed. */
+    void bind (juce::AudioProcessorParameter& parameter, std::function<void()> updateControl)
+    {
+        mUpdaters[(size_t) parameter.getParameterIndex()] = std::move (updateControl);
+    }
+
+    /** Moves slider to the parameter's value, without sending it back. */
+    void bind (juce::Slider& slider, juce::RangedAudioParameter& parameter)
+    {
+        bind (parameter, [&slider, &parameter] {
+            slider.setValue (parameter.convertFrom0to1 (parameter.getValue()), juce::dontSendNotification);
+        });
+    }
+
+    /** Brings every bound control up to date now, e.g. at the end of the editor's constructor. */
+    void updateAll()
+    {
+        for (auto& updateControl : mUpdaters)
+            if (updateControl != nullptr)
+                updateControl();
+    }
+
+private:
+    static constexpr int bitsPerWord = 32;
+
+    void parameterValueChanged (int parameterIndex, float) override
+    {
+        if (juce::isPositiveAndBelow (parameterIndex, (int) mUpdaters.size()))
+            mDirty[(size_t) (parameterIndex / bitsPerWord)].fetch_or (1u << (parameterIndex % bitsPerWord), std::memory_order_relaxed);
+    }
+
+    void parameterGestureChanged (int, bool) override {}
+
+    /** Once per display frame. */
+    void update()
+    {
+        for (size_t word = 0; word < mNumWords; ++word)
+        {
+            auto bits = mDirty[word].exchange (0, std::memory_order_relaxed);
+
+            while (bits != 0)
+            {
+                const auto lowest = bits & (~bits + 1u);
+                const auto index = word * bitsPerWord + (size_t) juce::findHighestSetBit (lowest);
+                bits ^= lowest;
+
+                if (mUpdaters[index] != nullptr)
+                    mUpdaters[index]();
+            }
+        }
+    }
+
+    const juce::Array<juce::AudioProcessorParameter*>& mParameters;
+    const size_t mNumWords;
+    std::unique_ptr<std::atomic<juce::uint32>[]> mDirty;
+    std::vector<std::function<void()>> mUpdaters;
+
+    juce::VBlankAttachment mVBlank;
+
+    JUCE_DECLARE_NON_COPYABLE (ParameterSync)
+};
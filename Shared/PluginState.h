@@ -0,0 +1,215 @@
+/*
+  ==============================================================================
+
+    PluginState.h
+
+    The state blob every plugin here saves from getStateInformation: a
+    small header and one fixed-size entry per parameter, so a session
+    with hundreds of instances loads without building any XML or
+    ValueTrees. Reading it allocates nothing.
+
+    Layout (little endian):
+        "JPST", uint16 version, uint16 headerSize, uint32 pluginID,
+        uint32 numParameters, then numParameters x
+        { uint32 parameterIDHash, float normalisedValue }
+
+    pluginID is the hash of a name each processor fixes at compile time
+    (see stateID in the processors), so it costs nothing per call and
+    stays apart for plugins linked into one binary, which share
+    JucePlugin_Name. Version 1 blobs hashed getName() instead, and are
+    still read.
+
+    Entries are written in parameter index order and matched back by the
+    hash of their parameter ID, so a blob still loads after parameters
+    are added (new ones keep their defaults). Later versions may grow the
+    header: readers skip headerSize bytes to the entries.
+
+    Parameters that aren't automatable, like QualityLevelParameter, are
+    read-outs rather than settings and aren't saved.
+
+    readLegacyXml() and readLegacyValueTree() load the blobs written
+    before this format (copyXmlToBinary and ValueTree::writeToStream).
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace PluginState
+{
+    static constexpr char magic[4] = { 'J', 'P', 'S', 'T' };
+    static constexpr juce::uint16 version = 2;
+    static constexpr int headerSize = 16;
+    static constexpr int entrySize = 8;
+
+    /** FNV-1a over the UTF-8 bytes, stable across runs and JUCE versions. */
+    constexpr juce::uint32 hash (const char* text) noexcept
+    {
+        juce::uint32 h = 2166136261u;
+
+        for (auto* p = text; *p != 0; ++p)
+            h = (h ^ (juce::uint8) *p) * 16777619u;
+
+        return h;
+    }
+
+    inline juce::uint32 hash (const juce::String& text) noexcept
+    {
+        return hash (text.toRawUTF8());
+    }
+
+    inline juce::uint32 getParameterIDHash (juce::AudioProcessorParameter& parameter) noexcept
+    {
+        if (auto* withID = dynamic_cast<juce::AudioProcessorParameterWithID*> (&parameter))
+            return hash (withID->paramID);
+
+        return (juce::uint32) parameter.getParameterIndex();
+    }
+
+    inline bool isSaved (juce::AudioProcessorParameter& parameter) noexcept
+    {
+        return parameter.isAutomatable();
+    }
+
+    //==============================================================================
+    /** Saves every saved parameter, tagged with pluginID. */
+    inline void write (juce::AudioProcessor& processor, juce::uint32 pluginID, juce::MemoryBlock& destData)
+    {
+        const auto& parameters = processor.getParameters();
+
+        juce::uint32 numSaved = 0;
+
+        for (auto* parameter : parameters)
+            if (isSaved (*parameter))
+                ++numSaved;
+
+        destData.setSize ((size_t) (headerSize + entrySize * (int) numSaved));
+        auto* out = static_cast<char*> (destData.getData());
+
+        auto put32 = [&out] (juce::uint32 value)
+        {
+            value = juce::ByteOrder::swapIfBigEndian (value);
+            std::memcpy (out, &value, sizeof (value));
+            out += sizeof (value);
+        };
+
+        auto put16 = [&out] (juce::uint16 value)
+        {
+            value = juce::ByteOrder::swapIfBigEndian (value);
+            std::memcpy (out, &value, sizeof (value));
+            out += sizeof (value);
+        };
+
+        std::memcpy (out, magic, sizeof (magic));
+        out += sizeof (magic);
+        put16 (version);
+        put16 ((juce::uint16) headerSize);
+        put32 (pluginID);
+        put32 (numSaved);
+
+        for (auto* parameter : parameters)
+        {
+            if (! isSaved (*parameter))
+                continue;
+
+            const auto value = parameter->getValue();
+            juce::uint32 bits;
+            std::memcpy (&bits, &value, sizeof (bits));
+
+            put32 (getParameterIDHash (*parameter));
+            put32 (bits);
+        }
+    }
+
+    /** Loads a blob from write(). False, leaving every parameter alone, if
+        it isn't one (e.g. a legacy blob) or was written by another plugin.
+    */
+    inline bool read (juce::AudioProcessor& processor, juce::uint32 pluginID, const void* data, int sizeInBytes)
+    {
+        auto* in = static_cast<const char*> (data);
+
+        if (data == nullptr || sizeInBytes < headerSize || std::memcmp (in, magic, sizeof (magic)) != 0)
+            return false;
+
+        const auto blobVersion = juce::ByteOrder::littleEndianShort (in + 4);
+        const auto blobHeaderSize = (int) juce::ByteOrder::littleEndianShort (in + 6);
+        const auto blobPluginID = juce::ByteOrder::littleEndianInt (in + 8);
+        const auto numEntries = (int) juce::ByteOrder::littleEndianInt (in + 12);
+
+        if (blobPluginID != (blobVersion < 2 ? hash (processor.getName()) : pluginID)
+             || blobHeaderSize < headerSize
+             || numEntries < 0
+             || (juce::int64) blobHeaderSize + (juce::int64) entrySize * numEntries > sizeInBytes)
+            return false;
+
+        const auto& parameters = processor.getParameters();
+        auto* entries = in + blobHeaderSize;
+
+        for (int entry = 0; entry < numEntries; ++entry)
+        {
+            const auto idHash = juce::ByteOrder::littleEndianInt (entries + entry * entrySize);
+            const auto bits = juce::ByteOrder::littleEndianInt (entries + entry * entrySize + 4);
+
+            float value;
+            std::memcpy (&value, &bits, sizeof (value));
+
+            // entries are usually in index order, so look where this one was first
+            juce::AudioProcessorParameter* target = nullptr;
+
+            if (entry < parameters.size() && getParameterIDHash (*parameters.getUnchecked (entry)) == idHash)
+                target = parameters.getUnchecked (entry);
+            else
+                for (auto* parameter : parameters)
+                    if (getParameterIDHash (*parameter) == idHash)
+                        target = parameter;
+
+            if (target != nullptr && isSaved (*target) && std::isfinite (value))
+                target->setValueNotifyingHost (juce::jlimit (0.0f, 1.0f, value));
+        }
+
+        return true;
+    }
+
+    //==============================================================================
+    /** Sets the parameter whose ID matches id (ignoring case) to a plain,
+        unnormalised value, as the legacy formats stored them.
+    */
+    inline void setLegacyValue (juce::AudioProcessor& processor, const juce::String& id, float value)
+    {
+        for (auto* parameter : processor.getParameters())
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (parameter))
+                if (ranged->paramID.equalsIgnoreCase (id) && isSaved (*ranged))
+                    ranged->setValueNotifyingHost (ranged->convertTo0to1 (value));
+    }
+
+    /** Loads a copyXmlToBinary blob whose attributes are named like the parameter IDs. */
+    inline bool readLegacyXml (juce::AudioProcessor& processor, const void* data, int sizeInBytes, const juce::String& tagName)
+    {
+        std::unique_ptr<juce::XmlElement> xml (juce::AudioProcessor::getXmlFromBinary (data, sizeInBytes));
+
+        if (xml == nullptr || ! xml->hasTagName (tagName))
+            return false;
+
+        for (int i = 0; i < xml->getNumAttributes(); ++i)
+            setLegacyValue (processor, xml->getAttributeName (i), (float) xml->getAttributeValue (i).getDoubleValue());
+
+        return true;
+    }
+
+    /** Loads a ValueTree::writeToStream blob of AudioProcessorValueTreeState, with "id" and "value" children. */
+    inline bool readLegacyValueTree (juce::AudioProcessor& processor, const void* data, int sizeInBytes)
+    {
+        const auto tree = juce::ValueTree::readFromData (data, (size_t) sizeInBytes);
+
+        if (! tree.isValid())
+            return false;
+
+        for (const auto& child : tree)
+            if (child.hasProperty ("id") && child.hasProperty ("value"))
+                setLegacyValue (processor, child["id"].toString(), (float) child["value"]);
+
+        return true;
+    }
+}
@@ -0,0 +1,259 @@
+/*
+  ==============================================================================
+
+    PresetBank.h
+
+    The programs of a processor: a fixed number of preallocated parameter
+    snapshots, and a morph from whatever is playing to the selected one.
+
+    Selecting a preset on the message thread publishes it to the audio
+    thread with a single atomic pointer store. At its next block the
+    audio thread starts moving every saved parameter (see PluginState)
+    from its current value to the preset's, linearly in normalised terms,
+    over the morph time. Discrete parameters (choices, ints and switches)
+    go straight to the preset's value as the morph starts, rather than
+    stepping through every value in between, so the continuous ones
+    morph within the preset's modes. While the morph runs, processors
+    read their parameters through read(), which gives the morphed
+    values, so no parameter steps mid-block.
+
+    Once the morph has arrived, the audio thread sets the parameters to
+    the preset's values and read() goes straight back to them, so host
+    automation and state loads take over again at the next block. The
+    host and editors are told from the message thread, by a timer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+#include "PluginState.h"
+
+class PresetBank  : private juce::Timer
+{
+public:
+    static constexpr double defaultMorphSeconds = 0.25;
+
+    /** Call once every parameter has been added. Every preset starts out as the parameters' defaults. */
+    PresetBank (juce::AudioProcessor& processor, int numPresets)
+    {
+        const auto& parameters = processor.getParameters();
+        mSlotForIndex.resize ((size_t) parameters.size(), -1);
+
+        for (auto* parameter : parameters)
+        {
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (parameter))
+            {
+                if (PluginState::isSaved (*ranged))
+                {
+                    mSlotForIndex[(size_t) ranged->getParameterIndex()] = (int) mParameters.size();
+                    mParameters.push_back (ranged);
+                    mIsDiscrete.push_back (ranged->isDiscrete());
+                }
+            }
+        }
+
+        for (int i = 0; i < juce::jmax (1, numPresets); ++i)
+        {
+            mPresets.push_back (std::make_unique<Preset> (mParameters.size()));
+
+            for (size_t slot = 0; slot < mParameters.size(); ++slot)
+                mPresets.back()->values[slot] = mParameters[slot]->getDefaultValue();
+        }
+
+        mFrom.resize (mParameters.size());
+        mCurrent.resize (mParameters.size());
+        mChanged = std::vector<std::atomic<bool>> (mParameters.size());
+
+        startTimerHz (30);
+    }
+
+    ~PresetBank() override
+    {
+        stopTimer();
+    }
+
+    //==============================================================================
+    // message thread
+
+    /** Names preset index and sets its values, as plain (unnormalised)
+        values by parameter ID. Parameters not listed keep their defaults.
+    */
+    void setPreset (int index, const juce::String& name, std::initializer_list<std::pair<const char*, float>> plainValues)
+    {
+        auto& preset = *mPresets[(size_t) index];
+        preset.name = name;
+
+        for (size_t slot = 0; slot < mParameters.size(); ++slot)
+        {
+            auto value = mParameters[slot]->getDefaultValue();
+
+            for (auto& idAndValue : plainValues)
+                if (mParameters[slot]->paramID == idAndValue.first)
+                    value = mParameters[slot]->convertTo0to1 (idAndValue.second);
+
+            preset.values[slot] = value;
+        }
+    }
+
+    /** Overwrites preset index with the parameters' current values. */
+    void storeCurrent (int index)
+    {
+        auto& preset = *mPresets[(size_t) index];
+
+        for (size_t slot = 0; slot < mParameters.size(); ++slot)
+            preset.values[slot] = mParameters[slot]->getValue();
+    }
+
+    int getNumPresets() const noexcept                              { return (int) mPresets.size(); }
+    int getCurrentPreset() const noexcept                           { return mCurrentPreset; }
+    juce::String getName (int index) const                          { return juce::isPositiveAndBelow (index, getNumPresets()) ? mPresets[(size_t) index]->name : juce::String(); }
+    void setName (int index, const juce::String& name)              { if (juce::isPositiveAndBelow (index, getNumPresets())) mPresets[(size_t) index]->name = name; }
+
+    /** Starts a morph to preset index from whatever the audio thread is playing. */
+    void select (int index)
+    {
+        if (! juce::isPositiveAndBelow (index, getNumPresets()))
+            return;
+
+        mCurrentPreset = index;
+        mPending.store (mPresets[(size_t) index].get(), std::memory_order_release);
+    }
+
+    /** 0 jumps straight to the preset (at the next block boundary). */
+    void setMorphTime (double seconds) noexcept    { mMorphSeconds = juce::jmax (0.0, seconds); }
+    double getMorphTime() const noexcept           { return mMorphSeconds; }
+
+    //==============================================================================
+    // audio thread
+
+    /** From prepareToPlay. */
+    void prepare (double sampleRate) noexcept      { mSampleRate = sampleRate; }
+
+    /** Picks up a newly selected preset and advances the morph by numSamples. Call before any read(). */
+    void beginBlock (int numSamples) noexcept
+    {
+        if (auto* next = mPending.exchange (nullptr, std::memory_order_acq_rel))
+        {
+            for (size_t slot = 0; slot < mParameters.size(); ++slot)
+            {
+                if (mIsDiscrete[slot])
+                    mFrom[slot] = next->values[slot].load (std::memory_order_relaxed);
+                else
+                    mFrom[slot] = mMorphing ? mCurrent[slot] : mParameters[slot]->getValue();
+            }
+
+            mTarget = next;
+            mMorphPosition = 0;
+            mMorphLength = juce::roundToInt (mMorphSeconds.load() * mSampleRate);
+            mMorphing = true;
+        }
+
+        if (! mMorphing)
+            return;
+
+        mMorphPosition = juce::jmin (mMorphLength, mMorphPosition + numSamples);
+        const auto t = mMorphLength > 0 ? (float) mMorphPosition / (float) mMorphLength : 1.0f;
+
+        for (size_t slot = 0; slot < mParameters.size(); ++slot)
+            mCurrent[slot] = mFrom[slot] + t * (mTarget->values[slot].load (std::memory_order_relaxed) - mFrom[slot]);
+
+        if (mMorphPosition >= mMorphLength)
+            arrive();
+    }
+
+    bool isMorphing() const noexcept  { return mMorphing; }
+
+    /** The parameter's value, or its morphed value while a morph runs. */
+    float read (juce::AudioParameterFloat& parameter) const noexcept    { return mMorphing ? getMorphedValue (parameter) : parameter.get(); }
+    int read (juce::AudioParameterInt& parameter) const noexcept        { return mMorphing ? juce::roundToInt (getMorphedValue (parameter)) : parameter.get(); }
+    int read (juce::AudioParameterChoice& parameter) const noexcept     { return mMorphing ? juce::roundToInt (getMorphedValue (parameter)) : parameter.getIndex(); }
+    bool read (juce::AudioParameterBool& parameter) const noexcept      { return mMorphing ? getMorphedValue (parameter) >= 0.5f : parameter.get(); }
+
+    /** For other parameter types, e.g. AudioProcessorValueTreeState's. */
+    float read (juce::RangedAudioParameter& parameter) const noexcept
+    {
+        return mMorphing ? getMorphedValue (parameter) : parameter.convertFrom0to1 (parameter.getValue());
+    }
+
+private:
+    struct Preset
+    {
+        explicit Preset (size_t numParameters) : values (numParameters) {}
+
+        juce::String name { "Init" };
+
+        // normalised, in slot order. Atomic so storeCurrent can run during a morph
+        std::vector<std::atomic<float>> values;
+    };
+
+    /** Hands the target's values to the parameters and ends the morph. */
+    void arrive() noexcept
+    {
+        for (size_t slot = 0; slot < mParameters.size(); ++slot)
+        {
+            const auto value = mTarget->values[slot].load (std::memory_order_relaxed);
+
+            // setValue only stores the value, as host automation does: the
+            // host hears about it from the timer
+            if (mParameters[slot]->getValue() != value)
+            {
+                mParameters[slot]->setValue (value);
+                mChanged[slot].store (true, std::memory_order_relaxed);
+            }
+        }
+
+        mMorphing = false;
+        mArrived.store (true, std::memory_order_release);
+    }
+
+    float getMorphedValue (juce::RangedAudioParameter& parameter) const noexcept
+    {
+        const auto index = (size_t) parameter.getParameterIndex();
+        const auto slot = index < mSlotForIndex.size() ? mSlotForIndex[index] : -1;
+
+        return parameter.convertFrom0to1 (slot >= 0 ? mCurrent[(size_t) slot] : parameter.getValue());
+    }
+
+    void timerCallback() override
+    {
+        if (mArrived.exchange (false, std::memory_order_acquire))
+        {
+            // whatever the parameters hold now, automation since included
+            for (size_t slot = 0; slot < mParameters.size(); ++slot)
+                if (mChanged[slot].exchange (false, std::memory_order_relaxed))
+                    mParameters[slot]->sendValueChangedMessageToListeners (mParameters[slot]->getValue());
+        }
+    }
+
+    std::vector<juce::RangedAudioParameter*> mParameters;
+    std::vector<bool> mIsDiscrete;
+    std::vector<int> mSlotForIndex;
+    std::vector<std::unique_ptr<Preset>> mPresets;
+    int mCurrentPreset = 0;
+
+    std::atomic<double> mMorphSeconds { defaultMorphSeconds };
+    double mSampleRate = 0.0;
+
+    // message thread -> audio thread: the preset to morph to
+    std::atomic<const Preset*> mPending { nullptr };
+
+    // audio thread -> message thread: a morph has arrived, and these
+    // parameters were set without the host being told
+    std::atomic<bool> mArrived { false };
+    std::vector<std::atomic<bool>> mChanged;
+
+    // audio thread only
+    const Preset* mTarget = nullptr;
+    std::vector<float> mFrom, mCurrent;
+    int mMorphPosition = 0;
+    int mMorphLength = 0;
+    bool mMorphing = false;
+
+    JUCE_DECLARE_NON_COPYABLE (PresetBank)
+};
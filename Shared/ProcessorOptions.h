@@ -0,0 +1,31 @@
+/*
+  ==============================================================================
+
+    ProcessorOptions.h
+
+    The per-instance settings every plugin here offers, for the tools that
+    only hold a juce::AudioProcessor (HeadlessRunner doesn't know which
+    plugin it was built with). dynamic_cast the processor to reach them.
+
+    Each one takes effect at the next prepareToPlay, and defaults to what
+    its environment variable asks for, so a host can still switch it on
+    for every instance at once.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+class ProcessorOptions
+{
+public:
+    virtual ~ProcessorOptions() = default;
+
+    /** Fixed block mode (see FixedBlockScheduler): 0 runs on the host's own
+        blocks, otherwise a size FixedBlockScheduler::isValidBlockSize takes.
+    */
+    virtual void setFixedBlockSize (int blockSize) = 0;
+
+    /** Spreads the channels of offline renders over a ChannelThreadPool. */
+    virtual void setParallelChannels (bool shouldProcessInParallel) = 0;
+};
@@ -0,0 +1,205 @@
+/*
+  ==============================================================================
+
+    QualityGovernor.h
+
+    Measures how much of its real-time budget each processBlock call uses
+    and steps the plugin down to cheaper internal modes under sustained
+    load, then back up once the load has stayed low for a while. Level 0
+    is full quality; what the higher levels drop is up to each plugin.
+
+    The load is smoothed over about 100 ms, so a single slow block (a page
+    fault, a preempted thread) doesn't change anything. Stepping down needs
+    250 ms above 75% of the budget, stepping up 2 s below 35%. The gap
+    between the two keeps a level that just fits from flapping.
+
+    Every level change starts a short crossfade. Processors render both the
+    old and the new level while it runs (see Ramp), so changing level
+    never clicks.
+
+    Offline renders have no budget, so they always run at level 0.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+class QualityGovernor
+{
+public:
+    static constexpr double loadSmoothingSeconds = 0.1;
+    static constexpr double stepDownLoad = 0.75;
+    static constexpr double stepDownSeconds = 0.25;
+    static constexpr double stepUpLoad = 0.35;
+    static constexpr double stepUpSeconds = 2.0;
+    static constexpr double crossfadeSeconds = 0.02;
+
+    /** Call from prepareToPlay. Levels run from 0 (full quality) to maxLevel. */
+    void prepare (double sampleRate, int maxLevel) noexcept
+    {
+        mSampleRate = sampleRate;
+        mMaxLevel = maxLevel;
+        mCrossfadeLength = juce::jmax (1, (int) (crossfadeSeconds * sampleRate));
+        mLevel.store (0, std::memory_order_relaxed);
+        mPreviousLevel = 0;
+        mCrossfadeRemaining = 0;
+        mSmoothedLoad = 0.0;
+        mSecondsAbove = 0.0;
+        mSecondsBelow = 0.0;
+    }
+
+    /** Call at the start of processBlock: offline renders always get full quality. */
+    void setRealtime (bool isRealtime) noexcept
+    {
+        mIsRealtime = isRealtime;
+
+        if (! isRealtime && getLevel() != 0)
+            changeLevel (0);
+    }
+
+    int getLevel() const noexcept  { return mLevel.load (std::memory_order_relaxed); }
+    int getMaxLevel() const noexcept  { return mMaxLevel; }
+
+    /** Feeds the time a processBlock call took into the load estimate. */
+    void blockFinished (double elapsedSeconds, int numSamples) noexcept
+    {
+        if (! mIsRealtime || numSamples <= 0 || mSampleRate <= 0.0)
+            return;
+
+        const auto blockSeconds = numSamples / mSampleRate;
+        const auto load = elapsedSeconds / blockSeconds;
+
+        mSmoothedLoad += (load - mSmoothedLoad) * (1.0 - std::exp (-blockSeconds / loadSmoothingSeconds));
+
+        mSecondsAbove = mSmoothedLoad > stepDownLoad ? mSecondsAbove + blockSeconds : 0.0;
+        mSecondsBelow = mSmoothedLoad < stepUpLoad   ? mSecondsBelow + blockSeconds : 0.0;
+
+        if (mSecondsAbove >= stepDownSeconds && getLevel() < mMaxLevel)
+            changeLevel (getLevel() + 1);
+        else if (mSecondsBelow >= stepUpSeconds && getLevel() > 0)
+            changeLevel (getLevel() - 1);
+    }
+
+    /** Times one processBlock call. */
+    struct ScopedBlockTimer
+    {
+        ScopedBlockTimer (QualityGovernor& g, int n) noexcept
+            : governor (g), numSamples (n), startTicks (juce::Time::getHighResolutionTicks()) {}
+
+        ~ScopedBlockTimer() noexcept
+        {
+            governor.blockFinished (juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks),
+                                    numSamples);
+        }
+
+        QualityGovernor& governor;
+        const int numSamples;
+        const juce::int64 startTicks;
+    };
+
+    /** The level to render a run of samples at. While a crossfade is running,
+        previousLevel differs from level and the output should be
+        previous * (1 - gain) + current * gain, with gain ramping linearly
+        from startGain to endGain over the run.
+    */
+    struct Ramp
+    {
+        int level;
+        int previousLevel;
+        float startGain;
+        float endGain;
+
+        bool isCrossfading() const noexcept  { return previousLevel != level; }
+
+        float getGain (int sampleIndex, int numSamples) const noexcept
+        {
+            return startGain + (endGain - startGain) * (float) sampleIndex / (float) numSamples;
+        }
+    };
+
+    /** Call once per run of samples, in order; advances the crossfade. */
+    Ramp getNextRamp (int numSamples) noexcept
+    {
+        const auto level = getLevel();
+
+        if (mCrossfadeRemaining <= 0)
+            return { level, level, 1.0f, 1.0f };
+
+        const auto startGain = 1.0f - (float) mCrossfadeRemaining / (float) mCrossfadeLength;
+        mCrossfadeRemaining = juce::jmax (0, mCrossfadeRemaining - numSamples);
+        const auto endGain = 1.0f - (float) mCrossfadeRemaining / (float) mCrossfadeLength;
+
+        return { level, mPreviousLevel, startGain, endGain };
+    }
+
+private:
+    void changeLevel (int newLevel) noexcept
+    {
+        mPreviousLevel = getLevel();
+        mLevel.store (newLevel, std::memory_order_relaxed);
+        mCrossfadeRemaining = mCrossfadeLength;
+        mSecondsAbove = 0.0;
+        mSecondsBelow = 0.0;
+    }
+
+    double mSampleRate = 0.0;
+    int mMaxLevel = 0;
+    bool mIsRealtime = true;
+
+    std::atomic<int> mLevel { 0 };
+    int mPreviousLevel = 0;
+    int mCrossfadeLength = 1;
+    int mCrossfadeRemaining = 0;
+
+    double mSmoothedLoad = 0.0;
+    double mSecondsAbove = 0.0;
+    double mSecondsBelow = 0.0;
+};
+
+//==============================================================================
+/** Shows the governor's level to the host and the editor. It is not
+    automatable, and anything written to it is overwritten by the next
+    update, since the processor only ever reads the governor itself.
+*/
+class QualityLevelParameter  : public juce::AudioParameterInt
+{
+public:
+    explicit QualityLevelParameter (int maxLevel)
+        : juce::AudioParameterInt ("quality", "Quality Reduction", 0, maxLevel, 0)
+    {
+    }
+
+    bool isAutomatable() const override  { return false; }
+};
+
+/** Copies the governor's level into its parameter from the message thread,
+    so the audio thread never calls into the host for it.
+*/
+class QualityLevelPublisher  : private juce::Timer
+{
+public:
+    QualityLevelPublisher (const QualityGovernor& governor, QualityLevelParameter& parameter)
+        : mGovernor (governor), mParameter (parameter)
+    {
+        startTimerHz (10);
+    }
+
+    ~QualityLevelPublisher() override
+    {
+        stopTimer();
+    }
+
+private:
+    void timerCallback() override
+    {
+        const auto level = mGovernor.getLevel();
+
+        if (mParameter.get() != level)
+            mParameter.setValueNotifyingHost (mParameter.convertTo0to1 ((float) level));
+    }
+
+    const QualityGovernor& mGovernor;
+    QualityLevelParameter& mParameter;
+};
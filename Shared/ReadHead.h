@@ -0,0 +1,158 @@
+/*
+  ==============================================================================
+
+    ReadHead.h
+
+    Delay line read heads as 32.32 fixed-point phase accumulators.
+
+    A float read position only has 24 bits, and a ring of MAX_DELAY_TIME
+    seconds at 192 kHz needs 19 of them for the sample index, which leaves
+    1/32 of a sample for modulation. A ReadHead::Position is a 64 bit
+    integer instead: the top 32 bits index the ring directly, the bottom
+    32 are the fraction between samples, 2^-32 of a sample anywhere in
+    the ring.
+
+    ReadHeadRamp moves a set of read heads at control rate. The delay is
+    evaluated once every interval samples (a control point), and between
+    two points every head moves by a constant increment per sample (the
+    write head's one sample, less the delay's change) in integer adds,
+    wrapped at the ring's length. Nothing
+    converts a float to an index per sample. An increment is rounded
+    towards zero and the rest carried into the next interval, so the
+    heads never drift from the evaluated delays.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace ReadHead
+{
+    using Position = juce::int64;
+
+    static constexpr int fractionBits = 32;
+    static constexpr Position oneSample = Position (1) << fractionBits;
+
+    inline Position fromSamples (double samples) noexcept   { return (Position) std::llround (samples * (double) oneSample); }
+
+    /** The ring index, for a position in [0, length). */
+    inline int getIndex (Position position) noexcept          { return (int) (position >> fractionBits); }
+
+    /** The fraction between getIndex and the next sample, in units of 2^-32. */
+    inline juce::uint32 getFraction (Position position) noexcept  { return (juce::uint32) position; }
+}
+
+//==============================================================================
+template <int numLanes>
+class ReadHeadRamp
+{
+public:
+    using Position = ReadHead::Position;
+
+    /** Starts every head delays[lane] samples behind writeIndex in a ring of
+        length samples, with the next control point interval samples away.
+    */
+    void reset (int length, int writeIndex, int interval, const double* delays) noexcept
+    {
+        jassert (interval > 0);
+
+        mLength = (Position) juce::jmax (1, length) << ReadHead::fractionBits;
+        mInterval = interval;
+        mSamplesRemaining = 0;
+
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            mDelay[lane] = ReadHead::fromSamples (delays[lane]);
+            mPosition[lane] = wrap (((Position) writeIndex << ReadHead::fractionBits) - mDelay[lane]);
+            mIncrement[lane] = ReadHead::oneSample;
+        }
+    }
+
+    /** Takes effect from the next control point. */
+    void setInterval (int interval) noexcept
+    {
+        jassert (interval > 0);
+        mInterval = interval;
+    }
+
+    /** Moves the heads on with a write head that advanced numSamples without
+        anything being read, keeping their delays where they were.
+    */
+    void skip (int numSamples) noexcept
+    {
+        for (int lane = 0; lane < numLanes; ++lane)
+            mPosition[lane] = (mPosition[lane] + (Position) numSamples * ReadHead::oneSample) % mLength;
+    }
+
+    /** Writes numSamples read positions to each of the numLanes dest arrays,
+        starting with the one for the sample the write head is on now.
+
+        evaluateControlPoint (int intervalLength, double* delays) is called once
+        per control point. It must advance its source by intervalLength samples
+        and write every lane's delay in samples at that point to delays.
+    */
+    template <typename EvaluateControlPoint>
+    void process (Position* const* dest, int numSamples, EvaluateControlPoint&& evaluateControlPoint) noexcept
+    {
+        for (int i = 0; i < numSamples;)
+        {
+            if (mSamplesRemaining == 0)
+            {
+                double delays[numLanes];
+                evaluateControlPoint (mInterval, delays);
+
+                for (int lane = 0; lane < numLanes; ++lane)
+                {
+                    const auto step = (ReadHead::fromSamples (delays[lane]) - mDelay[lane]) / mInterval;
+                    mDelay[lane] += step * mInterval;
+                    mIncrement[lane] = ReadHead::oneSample - step;
+                }
+
+                mSamplesRemaining = mInterval;
+            }
+
+            const int spanLength = juce::jmin (mSamplesRemaining, numSamples - i);
+
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                auto* laneDest = dest[lane] + i;
+                auto position = mPosition[lane];
+                const auto increment = mIncrement[lane];
+
+                // an increment is never as long as the ring, so one wrap at most
+                for (int j = 0; j < spanLength; ++j)
+                {
+                    laneDest[j] = position;
+                    position = wrap (position + increment);
+                }
+
+                mPosition[lane] = position;
+            }
+
+            i += spanLength;
+            mSamplesRemaining -= spanLength;
+        }
+    }
+
+private:
+    Position wrap (Position position) const noexcept
+    {
+        if (position >= mLength)
+            return position - mLength;
+
+        if (position < 0)
+            return position + mLength;
+
+        return position;
+    }
+
+    Position mLength = ReadHead::oneSample;
+    int mInterval = 16;
+    int mSamplesRemaining = 0;
+
+    Position mPosition[numLanes] = {};
+    Position mIncrement[numLanes] = {};
+    Position mDelay[numLanes] = {};
+};
@@ -0,0 +1,145 @@
+/*
+  ==============================================================================
+
+    RealtimeGuard.h
+
+    Debug-build detector for heap traffic on the audio thread. Put a
+    RealtimeGuard::ScopedAudioThread at the top of processBlock; any call to
+    the global operator new/delete (and, on glibc, malloc/free) made by that
+    thread while the scope is alive is counted, its stack trace recorded,
+    and by default it asserts.
+
+    The allocation hooks themselves live in RealtimeGuardAllocators.h, which
+    must be included by exactly one .cpp per binary.
+
+    Enabled when JUCE_PROJECTS_REALTIME_GUARD is 1, which defaults to
+    JUCE_DEBUG. In release builds everything here compiles to nothing.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef JUCE_PROJECTS_REALTIME_GUARD
+ #define JUCE_PROJECTS_REALTIME_GUARD JUCE_DEBUG
+#endif
+
+namespace RealtimeGuard
+{
+#if JUCE_PROJECTS_REALTIME_GUARD
+    static constexpr int maxRecordedViolations = 8;
+
+    struct ThreadState
+    {
+        int audioScopeDepth = 0;
+        bool reporting = false;
+    };
+
+    inline ThreadState& getThreadState() noexcept
+    {
+        static thread_local ThreadState state;
+        return state;
+    }
+
+    struct GlobalState
+    {
+        std::atomic<int> numViolations { 0 };
+        std::atomic<bool> assertOnViolation { true };
+        juce::SpinLock reportLock;
+        juce::String reports[maxRecordedViolations];
+    };
+
+    inline GlobalState& getGlobalState()
+    {
+        static GlobalState state;
+        return state;
+    }
+
+    /** Marks the current thread as running real-time code for the lifetime of the object. */
+    struct ScopedAudioThread
+    {
+        ScopedAudioThread() noexcept   { ++getThreadState().audioScopeDepth; }
+        ~ScopedAudioThread() noexcept  { --getThreadState().audioScopeDepth; }
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedAudioThread)
+    };
+
+    /** Temporarily lifts the guard, e.g. for deliberate, documented exceptions. */
+    struct ScopedSuspend
+    {
+        ScopedSuspend() noexcept : previous (getThreadState().reporting)  { getThreadState().reporting = true; }
+        ~ScopedSuspend() noexcept  { getThreadState().reporting = previous; }
+
+        bool previous;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedSuspend)
+    };
+
+    /** Called by the allocation hooks. */
+    inline void reportViolation (const char* what, size_t size) noexcept
+    {
+        auto& threadState = getThreadState();
+
+        if (threadState.audioScopeDepth <= 0 || threadState.reporting)
+            return;
+
+        // building the report allocates, so the hooks have to ignore this thread until we're done
+        ScopedSuspend suspend;
+
+        auto& state = getGlobalState();
+        auto index = state.numViolations.fetch_add (1);
+
+        if (index < maxRecordedViolations)
+        {
+            const juce::SpinLock::ScopedLockType lock (state.reportLock);
+            state.reports[index] = juce::String (what) + " (" + juce::String ((juce::uint64) size)
+                                     + " bytes) on the audio thread\n" + juce::SystemStats::getStackBacktrace();
+        }
+
+        if (state.assertOnViolation.load())
+        {
+            DBG (juce::String (what) << " on the audio thread");
+            jassertfalse;
+        }
+    }
+
+    inline void setAssertOnViolation (bool shouldAssert) noexcept  { getGlobalState().assertOnViolation = shouldAssert; }
+    inline int getNumViolations() noexcept                          { return getGlobalState().numViolations.load(); }
+
+    inline juce::StringArray getReports()
+    {
+        auto& state = getGlobalState();
+        const juce::SpinLock::ScopedLockType lock (state.reportLock);
+        juce::StringArray reports;
+
+        for (int i = 0; i < juce::jmin (state.numViolations.load(), maxRecordedViolations); ++i)
+            reports.add (state.reports[i]);
+
+        return reports;
+    }
+
+    inline void reset()
+    {
+        auto& state = getGlobalState();
+        const juce::SpinLock::ScopedLockType lock (state.reportLock);
+
+        for (auto& report : state.reports)
+            report = {};
+
+        state.numViolations = 0;
+    }
+
+    inline bool isEnabled() noexcept  { return true; }
+#else
+    struct ScopedAudioThread { ScopedAudioThread() noexcept {} };
+    struct ScopedSuspend     { ScopedSuspend() noexcept {} };
+
+    inline void setAssertOnViolation (bool) noexcept {}
+    inline int getNumViolations() noexcept           { return 0; }
+    inline juce::StringArray getReports()            { return {}; }
+    inline void reset() {}
+    inline bool isEnabled() noexcept                 { return false; }
+#endif
+}
@@ -0,0 +1,165 @@
+/*
+  ==============================================================================
+
+    RealtimeGuardAllocators.h
+
+    Replacements for the global allocation functions that report to
+    RealtimeGuard. Include this from exactly one .cpp per binary (each
+    plugin's PluginProcessor.cpp does).
+
+    operator new/delete are replaced on every platform. On glibc malloc,
+    calloc, realloc and free are intercepted too; that only covers the
+    whole process when the plugin code is linked into the executable, as
+    it is in the headless runner, not when a host dlopen()s the plugin.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "RealtimeGuard.h"
+
+#if JUCE_PROJECTS_REALTIME_GUARD
+
+#include <new>
+#include <cstdlib>
+
+#if JUCE_LINUX && defined (__GLIBC__)
+ #define JUCE_PROJECTS_REALTIME_GUARD_HOOKS_MALLOC 1
+
+extern "C"
+{
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+    void __libc_free (void*);
+    void* __libc_memalign (size_t, size_t);
+
+    void* malloc (size_t size)
+    {
+        RealtimeGuard::reportViolation ("malloc", size);
+        return __libc_malloc (size);
+    }
+
+    void* calloc (size_t count, size_t size)
+    {
+        RealtimeGuard::reportViolation ("calloc", count * size);
+        return __libc_calloc (count, size);
+    }
+
+    void* realloc (void* ptr, size_t size)
+    {
+        RealtimeGuard::reportViolation ("realloc", size);
+        return __libc_realloc (ptr, size);
+    }
+
+    void free (void* ptr)
+    {
+        if (ptr != nullptr)
+            RealtimeGuard::reportViolation ("free", 0);
+
+        __libc_free (ptr);
+    }
+}
+#else
+ #define JUCE_PROJECTS_REALTIME_GUARD_HOOKS_MALLOC 0
+#endif
+
+namespace RealtimeGuard
+{
+    // Bypasses our own malloc hook so that one operator new is reported once.
+    inline void* rawAllocate (size_t size) noexcept
+    {
+       #if JUCE_PROJECTS_REALTIME_GUARD_HOOKS_MALLOC
+        return __libc_malloc (size == 0 ? 1 : size);
+       #else
+        return std::malloc (size == 0 ? 1 : size);
+       #endif
+    }
+
+    inline void rawFree (void* ptr) noexcept
+    {
+       #if JUCE_PROJECTS_REALTIME_GUARD_HOOKS_MALLOC
+        __libc_free (ptr);
+       #else
+        std::free (ptr);
+       #endif
+    }
+
+    inline void* rawAllocateAligned (size_t size, size_t alignment) noexcept
+    {
+       #if JUCE_WINDOWS
+        return _aligned_malloc (size == 0 ? 1 : size, alignment);
+       #elif JUCE_PROJECTS_REALTIME_GUARD_HOOKS_MALLOC
+        return __libc_memalign (alignment, size == 0 ? 1 : size);
+       #else
+        void* ptr = nullptr;
+        return posix_memalign (&ptr, juce::jmax (alignment, sizeof (void*)), size == 0 ? 1 : size) == 0 ? ptr : nullptr;
+       #endif
+    }
+
+    inline void rawFreeAligned (void* ptr) noexcept
+    {
+       #if JUCE_WINDOWS
+        _aligned_free (ptr);
+       #else
+        rawFree (ptr);
+       #endif
+    }
+
+    inline void* checkedNew (size_t size, const char* what)
+    {
+        reportViolation (what, size);
+
+        if (auto* ptr = rawAllocate (size))
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+
+    inline void* checkedNewAligned (size_t size, std::align_val_t alignment, const char* what)
+    {
+        reportViolation (what, size);
+
+        if (auto* ptr = rawAllocateAligned (size, static_cast<size_t> (alignment)))
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+
+    inline void checkedDelete (void* ptr, const char* what) noexcept
+    {
+        if (ptr != nullptr)
+            reportViolation (what, 0);
+
+        rawFree (ptr);
+    }
+
+    inline void checkedDeleteAligned (void* ptr, const char* what) noexcept
+    {
+        if (ptr != nullptr)
+            reportViolation (what, 0);
+
+        rawFreeAligned (ptr);
+    }
+}
+
+void* operator new (size_t size)                                     { return RealtimeGuard::checkedNew (size, "operator new"); }
+void* operator new[] (size_t size)                                   { return RealtimeGuard::checkedNew (size, "operator new[]"); }
+void* operator new (size_t size, const std::nothrow_t&) noexcept     { RealtimeGuard::reportViolation ("operator new", size); return RealtimeGuard::rawAllocate (size); }
+void* operator new[] (size_t size, const std::nothrow_t&) noexcept   { RealtimeGuard::reportViolation ("operator new[]", size); return RealtimeGuard::rawAllocate (size); }
+void* operator new (size_t size, std::align_val_t alignment)         { return RealtimeGuard::checkedNewAligned (size, alignment, "operator new"); }
+void* operator new[] (size_t size, std::align_val_t alignment)       { return RealtimeGuard::checkedNewAligned (size, alignment, "operator new[]"); }
+
+void operator delete (void* ptr) noexcept                            { RealtimeGuard::checkedDelete (ptr, "operator delete"); }
+void operator delete[] (void* ptr) noexcept                          { RealtimeGuard::checkedDelete (ptr, "operator delete[]"); }
+void operator delete (void* ptr, size_t) noexcept                    { RealtimeGuard::checkedDelete (ptr, "operator delete"); }
+void operator delete[] (void* ptr, size_t) noexcept                  { RealtimeGuard::checkedDelete (ptr, "operator delete[]"); }
+void operator delete (void* ptr, const std::nothrow_t&) noexcept     { RealtimeGuard::checkedDelete (ptr, "operator delete"); }
+void operator delete[] (void* ptr, const std::nothrow_t&) noexcept   { RealtimeGuard::checkedDelete (ptr, "operator delete[]"); }
+void operator delete (void* ptr, std::align_val_t) noexcept          { RealtimeGuard::checkedDeleteAligned (ptr, "operator delete"); }
+void operator delete[] (void* ptr, std::align_val_t) noexcept        { RealtimeGuard::checkedDeleteAligned (ptr, "operator delete[]"); }
+void operator delete (void* ptr, size_t, std::align_val_t) noexcept  { RealtimeGuard::checkedDeleteAligned (ptr, "operator delete"); }
+void operator delete[] (void* ptr, size_t, std::align_val_t) noexcept { RealtimeGuard::checkedDeleteAligned (ptr, "operator delete[]"); }
+
+#endif
@@ -0,0 +1,434 @@
+/*
+  ==============================================================================
+
+    SpillingHistory.h
+
+    Minutes of multichannel audio history for very long delays, with a
+    bounded RAM footprint. Disk does the bulk of the storing.
+
+    The audio thread pushes every sample it writes into a small RAM FIFO
+    (spillFifoSeconds). One background thread, shared by every instance,
+    moves it on into a ring in a memory-mapped temp file. The same thread
+    copies the region just ahead of each reader back out of the file into
+    a RAM prefetch ring (about 2 * prefetchSeconds). The audio thread only
+    ever touches the two RAM rings, so page faults and disk I/O happen on
+    the background thread alone. Nothing on the audio thread waits for it
+    either: if the history isn't there yet, it reads as silence and the
+    underrun is counted. If the background thread falls a whole FIFO
+    behind, new blocks are dropped (and counted) instead, and the file
+    gets silence in their place.
+
+    Offline renders (setRealtime (false)) may wait, and run faster than
+    the background thread can keep up with. There the rendering thread
+    does the spilling and prefetching itself whenever it would otherwise
+    drop or miss anything, so bounces are complete and repeatable.
+
+    The file is created the first time startSpilling() is called. History
+    starts at that point and positions before it read as silence. It lives
+    until release().
+
+    Positions are absolute sample counts since prepare(). Every ring slot is
+    position % size, as in the delay lines, so jumps need no bookkeeping
+    beyond knowing which positions are in RAM.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "RealtimeGuard.h"
+#include <mutex>
+
+class SpillingHistory  : private juce::TimeSliceClient
+{
+public:
+    static constexpr double spillFifoSeconds = 1.0;
+    static constexpr double prefetchSeconds = 0.5;
+
+    /** Reads can jump back this far without reseeking, which covers
+        interpolation and delay times that wobble from block to block. */
+    static constexpr int maxBackwardStep = 64;
+
+    SpillingHistory() = default;
+
+    ~SpillingHistory() override
+    {
+        release();
+    }
+
+    //==============================================================================
+    /** Call from prepareToPlay. Allocates the RAM rings only; nothing touches
+        the disk until startSpilling(). Reads must stay at least
+        spillFifoSeconds + prefetchSeconds behind the newest sample.
+    */
+    void prepare (int numChannels, double sampleRate, double historySeconds, int maxBlockSize)
+    {
+        release();
+
+        mNumChannels = numChannels;
+        mMaxBlockSize = maxBlockSize;
+        mHistoryLength = (juce::int64) (historySeconds * sampleRate) + 1;
+        mFifoLength = juce::jmax (2 * maxBlockSize, (int) (spillFifoSeconds * sampleRate));
+        mPrefetchLength = juce::nextPowerOfTwo ((int) (2.0 * prefetchSeconds * sampleRate) + 2 * maxBlockSize);
+
+        mFifo.setSize (numChannels, mFifoLength);
+        mFifo.clear();
+        mPrefetch.setSize (numChannels, mPrefetchLength);
+        mPrefetch.clear();
+
+        mNumPushed.store (0);
+        mDroppedUntil.store (0);
+        mSpillRequested.store (false);
+        mSpilled.store (0);
+
+        mReadPosition.store (0);
+        mReadGeneration.store (0);
+        mReadHighWater = 0;
+        mPrefetchStart.store (0);
+        mPrefetchEnd.store (0);
+        mPrefetchGeneration.store (0);
+
+        mNumUnderruns.store (0);
+        mNumDroppedSamples.store (0);
+
+        mThread->addTimeSliceClient (this);
+    }
+
+    /** Call from releaseResources. Waits for the background thread to be done
+        with this instance, then deletes the file. */
+    void release()
+    {
+        mThread->removeTimeSliceClient (this);
+
+        mMappedFile.reset();
+        mFile.reset();
+        mMappedSamples = nullptr;
+        mNumChannels = 0;
+    }
+
+    //==============================================================================
+    /** Audio thread. Starts recording from the next push; the file itself
+        is created on the background thread. */
+    void startSpilling() noexcept
+    {
+        if (mSpillRequested.load (std::memory_order_relaxed))
+            return;
+
+        // nothing spills until the flag is seen, so this is the audio thread's to set
+        mSpilled.store (mNumPushed.load (std::memory_order_relaxed), std::memory_order_relaxed);
+        mSpillRequested.store (true, std::memory_order_release);
+    }
+
+    bool isSpilling() const noexcept  { return mSpillRequested.load (std::memory_order_relaxed); }
+
+    /** Call at the start of processBlock. */
+    void setRealtime (bool isRealtime) noexcept  { mIsRealtime = isRealtime; }
+
+    /** Audio thread. Appends numSamples (at most maxBlockSize) to every channel. */
+    void push (const float* const* channels, int numSamples) noexcept
+    {
+        jassert (numSamples <= mMaxBlockSize);
+
+        const auto position = mNumPushed.load (std::memory_order_relaxed);
+
+        if (mSpillRequested.load (std::memory_order_relaxed))
+        {
+            // the FIFO's oldest slots are free once the background thread has spilled them
+            auto isFull = [&] { return position + numSamples - mSpilled.load (std::memory_order_acquire) > mFifoLength; };
+
+            if (isFull() && ! mIsRealtime)
+                serviceNow();
+
+            if (isFull())
+            {
+                mDroppedUntil.store (position + numSamples, std::memory_order_release);
+                mNumDroppedSamples.fetch_add (numSamples, std::memory_order_relaxed);
+            }
+            else
+            {
+                for (int channel = 0; channel < mNumChannels; ++channel)
+                    copyIntoRing (mFifo.getWritePointer (channel), mFifoLength, position, channels[channel], numSamples);
+            }
+        }
+
+        mNumPushed.store (position + numSamples, std::memory_order_release);
+    }
+
+    /** Position of the next sample push() will append. */
+    juce::int64 getNumSamplesPushed() const noexcept  { return mNumPushed.load (std::memory_order_relaxed); }
+
+    //==============================================================================
+    /** Audio thread, once per block before any read(). Returns true if every
+        position in [firstPosition, lastPosition] can be read from RAM. If it
+        returns false, the block should read as silence; the background thread
+        starts fetching from firstPosition.
+    */
+    bool beginRead (juce::int64 firstPosition, juce::int64 lastPosition) noexcept
+    {
+        auto generation = mReadGeneration.load (std::memory_order_relaxed);
+
+        // A jump back leaves positions the background thread may be
+        // recycling, so it needs a fresh window. The position is published
+        // first, so a new generation is never seen with an old position.
+        if (firstPosition < mReadHighWater - maxBackwardStep)
+        {
+            mReadHighWater = firstPosition;
+            mReadPosition.store (mReadHighWater, std::memory_order_relaxed);
+            mReadGeneration.store (++generation, std::memory_order_release);
+        }
+        else
+        {
+            mReadHighWater = juce::jmax (mReadHighWater, firstPosition);
+            mReadPosition.store (mReadHighWater, std::memory_order_release);
+        }
+
+        auto isReadable = [&]
+        {
+            return mPrefetchGeneration.load (std::memory_order_acquire) == generation
+                && firstPosition >= mPrefetchStart.load (std::memory_order_acquire)
+                && lastPosition < mPrefetchEnd.load (std::memory_order_acquire);
+        };
+
+        if (! isReadable() && ! mIsRealtime)
+            serviceNow();
+
+        if (! isReadable())
+        {
+            mNumUnderruns.fetch_add (1, std::memory_order_relaxed);
+            return false;
+        }
+
+        return true;
+    }
+
+    /** Audio thread, any channel, within the positions beginRead() accepted. */
+    float read (int channel, juce::int64 position, float fraction) const noexcept
+    {
+        const auto* ring = mPrefetch.getReadPointer (channel);
+        const auto mask = (juce::int64) mPrefetchLength - 1;
+
+        const auto x0 = ring[position & mask];
+        const auto x1 = ring[(position + 1) & mask];
+        return x0 + fraction * (x1 - x0);
+    }
+
+    //==============================================================================
+    int getNumUnderruns() const noexcept              { return mNumUnderruns.load(); }
+    juce::int64 getNumDroppedSamples() const noexcept { return mNumDroppedSamples.load(); }
+
+private:
+    //==============================================================================
+    struct SpillThread  : public juce::TimeSliceThread
+    {
+        SpillThread()  : juce::TimeSliceThread ("Delay history spill")  { startThread(); }
+        ~SpillThread() override                                         { stopThread (2000); }
+    };
+
+    static void copyIntoRing (float* ring, juce::int64 ringLength, juce::int64 position, const float* src, int numSamples) noexcept
+    {
+        while (numSamples > 0)
+        {
+            const auto slot = (int) (position % ringLength);
+            const auto n = (int) juce::jmin ((juce::int64) numSamples, ringLength - slot);
+
+            std::memcpy (ring + slot, src, (size_t) n * sizeof (float));
+
+            position += n;
+            src += n;
+            numSamples -= n;
+        }
+    }
+
+    static void clearRing (float* ring, juce::int64 ringLength, juce::int64 position, juce::int64 numSamples) noexcept
+    {
+        while (numSamples > 0)
+        {
+            const auto slot = position % ringLength;
+            const auto n = juce::jmin (numSamples, ringLength - slot);
+
+            std::fill (ring + slot, ring + slot + n, 0.0f);
+
+            position += n;
+            numSamples -= n;
+        }
+    }
+
+    static void copyBetweenRings (float* dest, juce::int64 destLength, const float* src, juce::int64 srcLength,
+                                  juce::int64 position, juce::int64 numSamples) noexcept
+    {
+        while (numSamples > 0)
+        {
+            const auto destSlot = position % destLength;
+            const auto srcSlot = position % srcLength;
+            const auto n = juce::jmin (numSamples, destLength - destSlot, srcLength - srcSlot);
+
+            std::memcpy (dest + destSlot, src + srcSlot, (size_t) n * sizeof (float));
+
+            position += n;
+            numSamples -= n;
+        }
+    }
+
+    //==============================================================================
+    int useTimeSlice() override
+    {
+        if (! mSpillRequested.load (std::memory_order_acquire))
+            return 50;
+
+        const std::lock_guard<std::mutex> lock (mServiceLock);
+
+        if (mMappedSamples == nullptr && ! openFile())
+            return 500;
+
+        spill();
+        prefetch();
+        return 5;
+    }
+
+    /** Offline only: the background thread's work, on the rendering thread. */
+    void serviceNow()
+    {
+        // offline, so opening the file here is allowed
+        RealtimeGuard::ScopedSuspend allowFileIO;
+        const std::lock_guard<std::mutex> lock (mServiceLock);
+
+        if (mMappedSamples != nullptr || openFile())
+        {
+            spill();
+            prefetch();
+        }
+    }
+
+    bool openFile()
+    {
+        const auto numBytes = (juce::int64) mNumChannels * mHistoryLength * (juce::int64) sizeof (float);
+
+        mFile = std::make_unique<juce::TemporaryFile> (".history");
+
+        {
+            // a new file reads as zeros, i.e. silence before spilling started
+            juce::FileOutputStream stream (mFile->getFile());
+
+            if (stream.failedToOpen() || ! stream.setPosition (numBytes - 1) || ! stream.writeByte (0))
+                return false;
+        }
+
+        mMappedFile = std::make_unique<juce::MemoryMappedFile> (mFile->getFile(), juce::MemoryMappedFile::readWrite, true);
+
+        if (mMappedFile->getData() == nullptr || (juce::int64) mMappedFile->getSize() < numBytes)
+        {
+            mMappedFile.reset();
+            return false;
+        }
+
+        mMappedSamples = static_cast<float*> (mMappedFile->getData());
+        return true;
+    }
+
+    /** FIFO -> file. */
+    void spill() noexcept
+    {
+        // pushed first: any drop before it is then visible too
+        const auto pushed = mNumPushed.load (std::memory_order_acquire);
+        const auto droppedUntil = mDroppedUntil.load (std::memory_order_acquire);
+        auto spilled = mSpilled.load (std::memory_order_relaxed);
+
+        // a drop means the FIFO was full, so everything up to it goes
+        if (spilled < droppedUntil)
+        {
+            for (int channel = 0; channel < mNumChannels; ++channel)
+                clearRing (mMappedSamples + channel * mHistoryLength, mHistoryLength, spilled, droppedUntil - spilled);
+
+            spilled = droppedUntil;
+        }
+
+        if (spilled < pushed)
+        {
+            for (int channel = 0; channel < mNumChannels; ++channel)
+                copyBetweenRings (mMappedSamples + channel * mHistoryLength, mHistoryLength,
+                                  mFifo.getReadPointer (channel), mFifoLength, spilled, pushed - spilled);
+
+            spilled = pushed;
+        }
+
+        mSpilled.store (spilled, std::memory_order_release);
+    }
+
+    /** File -> prefetch ring, from the reader's position onwards. */
+    void prefetch() noexcept
+    {
+        const auto generation = mReadGeneration.load (std::memory_order_acquire);
+        const auto readPosition = mReadPosition.load (std::memory_order_acquire);
+
+        // The reader never goes below readPosition - maxBackwardStep in this
+        // generation, so slots of positions older than that are free.
+        const auto oldestNeeded = readPosition - maxBackwardStep;
+
+        auto start = mPrefetchStart.load (std::memory_order_relaxed);
+        auto end = mPrefetchEnd.load (std::memory_order_relaxed);
+
+        // a jump back, or forward past what we have: start again from the reader
+        if (generation != mPrefetchGeneration.load (std::memory_order_relaxed) || oldestNeeded > end)
+        {
+            start = end = oldestNeeded;
+            mPrefetchEnd.store (end, std::memory_order_relaxed);
+            mPrefetchStart.store (start, std::memory_order_relaxed);
+            mPrefetchGeneration.store (generation, std::memory_order_release);
+        }
+
+        const auto target = juce::jmin (oldestNeeded + mPrefetchLength, mSpilled.load (std::memory_order_relaxed));
+
+        if (target <= end)
+            return;
+
+        for (int channel = 0; channel < mNumChannels; ++channel)
+            copyBetweenRings (mPrefetch.getWritePointer (channel), mPrefetchLength,
+                              mMappedSamples + channel * mHistoryLength, mHistoryLength, end, target - end);
+
+        mPrefetchStart.store (juce::jmax (start, target - mPrefetchLength), std::memory_order_release);
+        mPrefetchEnd.store (target, std::memory_order_release);
+    }
+
+    //==============================================================================
+    juce::SharedResourcePointer<SpillThread> mThread;
+
+    int mNumChannels = 0;
+    int mMaxBlockSize = 0;
+    juce::int64 mHistoryLength = 0;
+    int mFifoLength = 0;
+    int mPrefetchLength = 0;
+
+    // audio thread -> background thread
+    juce::AudioBuffer<float> mFifo;
+    std::atomic<juce::int64> mNumPushed { 0 };
+    std::atomic<juce::int64> mDroppedUntil { 0 };
+    std::atomic<bool> mSpillRequested { false };
+
+    // background thread -> audio thread: positions before this are in the file
+    std::atomic<juce::int64> mSpilled { 0 };
+
+    bool mIsRealtime = true;
+
+    // background thread only, or an offline render holding mServiceLock
+    std::mutex mServiceLock;
+    std::unique_ptr<juce::TemporaryFile> mFile;
+    std::unique_ptr<juce::MemoryMappedFile> mMappedFile;
+    float* mMappedSamples = nullptr;
+
+    // background thread -> audio thread
+    juce::AudioBuffer<float> mPrefetch;
+    std::atomic<juce::int64> mPrefetchStart { 0 };
+    std::atomic<juce::int64> mPrefetchEnd { 0 };
+    std::atomic<int> mPrefetchGeneration { 0 };
+
+    // audio thread -> background thread
+    std::atomic<juce::int64> mReadPosition { 0 };
+    std::atomic<int> mReadGeneration { 0 };
+    juce::int64 mReadHighWater = 0;
+
+    std::atomic<int> mNumUnderruns { 0 };
+    std::atomic<juce::int64> mNumDroppedSamples { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (SpillingHistory)
+};
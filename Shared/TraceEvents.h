@@ -0,0 +1,159 @@
+/*
+  ==============================================================================
+
+    TraceEvents.h
+
+    Opt-in scoped trace markers that can be dumped as a Chrome trace JSON
+    file (chrome://tracing or https://ui.perfetto.dev).
+
+    Build with JUCE_PROJECTS_TRACING=1 to enable. When it is 0 (the default)
+    TRACE_SCOPE expands to nothing, so the markers cost nothing.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef JUCE_PROJECTS_TRACING
+ #define JUCE_PROJECTS_TRACING 0
+#endif
+
+namespace TraceEvents
+{
+#if JUCE_PROJECTS_TRACING
+    struct Event
+    {
+        const char* name;
+        juce::int64 startTicks;
+        juce::int64 endTicks;
+    };
+
+    static constexpr int maxThreads = 16;
+    static constexpr int eventsPerThread = 1 << 14; // ring, oldest events get overwritten
+
+    // One buffer per thread, preallocated in static storage. Only the owning
+    // thread writes to it, so recording is a plain store plus a release of
+    // the write count.
+    struct ThreadBuffer
+    {
+        std::atomic<int> numWritten { 0 };
+        Event events[eventsPerThread];
+    };
+
+    inline ThreadBuffer* getThreadBuffers() noexcept
+    {
+        static ThreadBuffer buffers[maxThreads];
+        return buffers;
+    }
+
+    inline std::atomic<int>& getNumThreadsClaimed() noexcept
+    {
+        static std::atomic<int> numClaimed { 0 };
+        return numClaimed;
+    }
+
+    inline ThreadBuffer* getBufferForThisThread() noexcept
+    {
+        static thread_local ThreadBuffer* buffer = nullptr;
+        static thread_local bool claimed = false;
+
+        if (! claimed)
+        {
+            claimed = true;
+            auto index = getNumThreadsClaimed().fetch_add (1);
+
+            if (index < maxThreads)
+                buffer = getThreadBuffers() + index;
+        }
+
+        return buffer;
+    }
+
+    inline void record (const char* name, juce::int64 startTicks, juce::int64 endTicks) noexcept
+    {
+        if (auto* buffer = getBufferForThisThread())
+        {
+            auto n = buffer->numWritten.load (std::memory_order_relaxed);
+            buffer->events[n & (eventsPerThread - 1)] = { name, startTicks, endTicks };
+            buffer->numWritten.store (n + 1, std::memory_order_release);
+        }
+    }
+
+    struct Scope
+    {
+        explicit Scope (const char* eventName) noexcept
+            : name (eventName), startTicks (juce::Time::getHighResolutionTicks()) {}
+
+        ~Scope() noexcept  { record (name, startTicks, juce::Time::getHighResolutionTicks()); }
+
+        const char* name;
+        juce::int64 startTicks;
+
+        JUCE_DECLARE_NON_COPYABLE (Scope)
+    };
+
+    /** Discards everything recorded so far. Only call this while no thread is tracing. */
+    inline void clear() noexcept
+    {
+        for (int i = 0; i < maxThreads; ++i)
+            getThreadBuffers()[i].numWritten.store (0);
+    }
+
+    /** Writes all recorded events as Chrome trace JSON. Call this once the
+        traced threads have stopped processing, it is not meant to run
+        concurrently with recording.
+    */
+    inline bool writeChromeTrace (const juce::File& file)
+    {
+        file.deleteFile();
+        juce::FileOutputStream out (file);
+
+        if (! out.openedOk())
+            return false;
+
+        auto ticksPerMicrosecond = (double) juce::Time::getHighResolutionTicksPerSecond() / 1.0e6;
+        auto numThreads = juce::jmin (getNumThreadsClaimed().load(), maxThreads);
+        bool first = true;
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+        for (int thread = 0; thread < numThreads; ++thread)
+        {
+            auto& buffer = getThreadBuffers()[thread];
+            auto numWritten = buffer.numWritten.load (std::memory_order_acquire);
+
+            for (int n = juce::jmax (0, numWritten - eventsPerThread); n < numWritten; ++n)
+            {
+                auto& e = buffer.events[n & (eventsPerThread - 1)];
+
+                out << (first ? "\n" : ",\n")
+                    << "{\"name\":" << juce::JSON::toString (juce::String (e.name))
+                    << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+                    << ",\"ts\":" << juce::String ((double) e.startTicks / ticksPerMicrosecond, 3)
+                    << ",\"dur\":" << juce::String ((double) (e.endTicks - e.startTicks) / ticksPerMicrosecond, 3)
+                    << "}";
+
+                first = false;
+            }
+        }
+
+        out << "\n]}\n";
+        out.flush();
+        return out.getStatus().wasOk();
+    }
+
+    inline bool isEnabled() noexcept  { return true; }
+#else
+    inline void clear() noexcept {}
+    inline bool writeChromeTrace (const juce::File&)  { return false; }
+    inline bool isEnabled() noexcept  { return false; }
+#endif
+}
+
+#if JUCE_PROJECTS_TRACING
+ #define TRACE_SCOPE(name)  TraceEvents::Scope JUCE_JOIN_MACRO (traceScope_, __LINE__) (name)
+#else
+ #define TRACE_SCOPE(name)
+#endif
@@ -0,0 +1,444 @@
+/*
+  ==============================================================================
+
+    Batch processor: runs every audio file in a directory through a chain of
+    the plugins in this repo, without a host.
+
+    Build it as a console app together with the Source folders of all three
+    plugins and JUCE_PROJECTS_MULTI_PLUGIN_BUILD=1 in the preprocessor
+    definitions. That leaves out each plugin's createPluginFilter() and
+    allocator hooks, which may only be linked once.
+
+    Files are streamed through the chain in fixed-size chunks with
+    AudioFormatReader/AudioFormatWriter, so memory use doesn't depend on
+    file length. Several files are processed at once, one per worker
+    thread, and each file gets a freshly prepared chain, so no delay tail
+    leaks from one file into the next. The output keeps the input's
+    format, bit depth and relative path.
+
+    A chain is a list of stages separated by ';', each a processor name
+    (delay, coflanger or distortion) with optional parameter values in
+    their real units, by parameter ID:
+
+        BatchProcessor --chain "distortion:drive=0.6,blend=0.4;delay:delaytime=0.25,drywet=0.3"
+                       --input samples/ --output processed/
+                       [--jobs 8] [--block 4096] [--tail 0] [--fixed-block 0]
+                       [--parallel-channels]
+
+    --tail appends that many seconds of silence to every file, to keep
+    the delay and modulation tails.
+
+    --fixed-block n runs every stage in fixed block mode (see
+    Shared/FixedBlockScheduler.h) with blocks of n samples. The latency
+    that adds is taken back out, so the output still lines up with the
+    input.
+
+    --parallel-channels spreads each file's channels over a thread pool per
+    stage (see Shared/ChannelThreadPool.h). It suits a few wide stems
+    better than many files: lower --jobs to match.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Delay/Source/PluginProcessor.h"
+#include "../../../Coflanger/Source/PluginProcessor.h"
+#include "../../../Distortion/Source/PluginProcessor.h"
+#include "../../../Shared/CpuDispatch.h"
+#include "../../../Shared/ProcessorOptions.h"
+#include "../../../Shared/RealtimeGuard.h"
+#include "../../../Shared/RealtimeGuardAllocators.h"
+
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    struct StageSpec
+    {
+        juce::String processorName;
+        juce::StringArray parameterIDs;
+        juce::Array<float> values;
+    };
+
+    struct BatchOptions
+    {
+        juce::Array<StageSpec> chain;
+        juce::File inputDirectory;
+        juce::File outputDirectory;
+        int numJobs = juce::SystemStats::getNumCpus();
+        int blockSize = 4096;
+        double tailSeconds = 0.0;
+        int fixedBlockSize = 0;
+        bool parallelChannels = false;
+    };
+
+    std::unique_ptr<juce::AudioProcessor> createProcessor (const juce::String& name)
+    {
+        if (name == "delay")      return std::make_unique<DelayKadenzeAudioProcessor>();
+        if (name == "coflanger")  return std::make_unique<CoflangerAudioProcessor>();
+        if (name == "distortion") return std::make_unique<DistortionAudioProcessor>();
+
+        return {};
+    }
+
+    juce::RangedAudioParameter* findParameter (juce::AudioProcessor& processor, const juce::String& parameterID)
+    {
+        for (auto* parameter : processor.getParameters())
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (parameter))
+                if (ranged->paramID == parameterID)
+                    return ranged;
+
+        return nullptr;
+    }
+
+    bool parseChain (const juce::String& text, juce::Array<StageSpec>& chain)
+    {
+        for (auto& stageText : juce::StringArray::fromTokens (text, ";", {}))
+        {
+            if (stageText.trim().isEmpty())
+                continue;
+
+            StageSpec stage;
+            stage.processorName = stageText.upToFirstOccurrenceOf (":", false, false).trim().toLowerCase();
+
+            auto processor = createProcessor (stage.processorName);
+
+            if (processor == nullptr)
+            {
+                std::cerr << "unknown processor '" << stage.processorName << "' (use delay, coflanger or distortion)" << std::endl;
+                return false;
+            }
+
+            for (auto& assignment : juce::StringArray::fromTokens (stageText.fromFirstOccurrenceOf (":", false, false), ",", {}))
+            {
+                if (assignment.trim().isEmpty())
+                    continue;
+
+                auto parameterID = assignment.upToFirstOccurrenceOf ("=", false, false).trim();
+
+                if (findParameter (*processor, parameterID) == nullptr || ! assignment.contains ("="))
+                {
+                    std::cerr << stage.processorName << ": no parameter '" << parameterID << "', it has:";
+
+                    for (auto* parameter : processor->getParameters())
+                        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (parameter))
+                            std::cerr << " " << ranged->paramID;
+
+                    std::cerr << std::endl;
+                    return false;
+                }
+
+                stage.parameterIDs.add (parameterID);
+                stage.values.add (assignment.fromFirstOccurrenceOf ("=", false, false).trim().getFloatValue());
+            }
+
+            chain.add (stage);
+        }
+
+        return ! chain.isEmpty();
+    }
+
+    bool parseOptions (const juce::ArgumentList& args, BatchOptions& options)
+    {
+        if (! args.containsOption ("--chain") || ! args.containsOption ("--input") || ! args.containsOption ("--output"))
+        {
+            std::cerr << "usage: BatchProcessor --chain \"stage;stage...\" --input dir --output dir"
+                         " [--jobs n] [--block n] [--tail seconds] [--fixed-block n] [--parallel-channels]" << std::endl;
+            return false;
+        }
+
+        if (! parseChain (args.getValueForOption ("--chain"), options.chain))
+            return false;
+
+        options.inputDirectory = args.getFileForOption ("--input");
+        options.outputDirectory = args.getFileForOption ("--output");
+
+        if (! options.inputDirectory.isDirectory())
+        {
+            std::cerr << "no such directory: " << options.inputDirectory.getFullPathName() << std::endl;
+            return false;
+        }
+
+        if (args.containsOption ("--jobs"))
+            options.numJobs = args.getValueForOption ("--jobs").getIntValue();
+
+        if (args.containsOption ("--block"))
+            options.blockSize = args.getValueForOption ("--block").getIntValue();
+
+        if (args.containsOption ("--tail"))
+            options.tailSeconds = args.getValueForOption ("--tail").getDoubleValue();
+
+        if (args.containsOption ("--fixed-block"))
+            options.fixedBlockSize = args.getValueForOption ("--fixed-block").getIntValue();
+
+        options.parallelChannels = args.containsOption ("--parallel-channels");
+
+        if (options.numJobs <= 0 || options.blockSize <= 0 || options.tailSeconds < 0.0)
+        {
+            std::cerr << "invalid --jobs, --block or --tail" << std::endl;
+            return false;
+        }
+
+        if (! FixedBlockScheduler::isValidBlockSize (options.fixedBlockSize))
+        {
+            std::cerr << "invalid --fixed-block: 0 or a power of two from " << FixedBlockScheduler::minBlockSize
+                      << " to " << FixedBlockScheduler::maxBlockSize << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    //==============================================================================
+    struct FileResult
+    {
+        bool ok = false;
+        juce::String error;
+        juce::int64 numSamples = 0;
+        int numChannels = 0;
+        double sampleRate = 0.0;
+    };
+
+    FileResult processFile (const juce::File& inputFile, const juce::File& outputFile,
+                            const BatchOptions& options, juce::AudioFormatManager& formatManager)
+    {
+        FileResult result;
+
+        std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (inputFile));
+
+        if (reader == nullptr)
+        {
+            result.error = "can't read";
+            return result;
+        }
+
+        result.numChannels = (int) reader->numChannels;
+        result.sampleRate = reader->sampleRate;
+
+        std::vector<std::unique_ptr<juce::AudioProcessor>> chain;
+
+        for (auto& stage : options.chain)
+        {
+            auto processor = createProcessor (stage.processorName);
+
+            for (int i = 0; i < stage.parameterIDs.size(); ++i)
+            {
+                auto* parameter = findParameter (*processor, stage.parameterIDs[i]);
+                parameter->setValue (parameter->convertTo0to1 (stage.values[i]));
+            }
+
+            // setPlayConfigDetails takes any channel count, so ask the
+            // processor itself whether it can run this many
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add (juce::AudioChannelSet::discreteChannels (result.numChannels));
+            layout.outputBuses.add (juce::AudioChannelSet::discreteChannels (result.numChannels));
+
+            if (! processor->checkBusesLayoutSupported (layout))
+            {
+                result.error = stage.processorName + " doesn't support " + juce::String (result.numChannels) + " channels";
+                return result;
+            }
+
+            if (auto* withOptions = dynamic_cast<ProcessorOptions*> (processor.get()))
+            {
+                withOptions->setFixedBlockSize (options.fixedBlockSize);
+                withOptions->setParallelChannels (options.parallelChannels);
+            }
+
+            processor->setNonRealtime (true);
+            processor->setPlayConfigDetails (result.numChannels, result.numChannels, reader->sampleRate, options.blockSize);
+
+            processor->prepareToPlay (reader->sampleRate, options.blockSize);
+            chain.push_back (std::move (processor));
+        }
+
+        auto* format = formatManager.findFormatForFileExtension (inputFile.getFileExtension());
+        auto bitsPerSample = (int) reader->bitsPerSample;
+
+        if (! format->getPossibleBitDepths().contains (bitsPerSample))
+            bitsPerSample = 24;
+
+        if (! outputFile.getParentDirectory().createDirectory().wasOk())
+        {
+            result.error = "can't create " + outputFile.getParentDirectory().getFullPathName();
+            return result;
+        }
+
+        outputFile.deleteFile();
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+
+        if (auto stream = outputFile.createOutputStream())
+        {
+            writer.reset (format->createWriterFor (stream.get(), reader->sampleRate, (unsigned int) result.numChannels,
+                                                   bitsPerSample, reader->metadataValues, 0));
+
+            if (writer != nullptr)
+                stream.release(); // now owned by the writer
+        }
+
+        if (writer == nullptr)
+        {
+            result.error = "can't write " + outputFile.getFullPathName();
+            return result;
+        }
+
+        juce::AudioBuffer<float> buffer (result.numChannels, options.blockSize);
+        juce::MidiBuffer midi;
+
+        // fixed block mode delays each stage's output; run on for that long
+        // and leave it out of the file
+        juce::int64 latency = 0;
+
+        for (auto& processor : chain)
+            latency += processor->getLatencySamples();
+
+        const auto numTailSamples = (juce::int64) (options.tailSeconds * reader->sampleRate);
+        const auto totalNumSamples = reader->lengthInSamples + numTailSamples + latency;
+
+        for (juce::int64 position = 0; position < totalNumSamples; position += options.blockSize)
+        {
+            const auto numSamples = (int) juce::jmin ((juce::int64) options.blockSize, totalNumSamples - position);
+            juce::AudioBuffer<float> view (buffer.getArrayOfWritePointers(), result.numChannels, numSamples);
+
+            // reading past the end of the file fills the tail with silence
+            if (! reader->read (&view, 0, numSamples, position, true, true))
+            {
+                result.error = "read failed at sample " + juce::String (position);
+                return result;
+            }
+
+            for (auto& processor : chain)
+                processor->processBlock (view, midi);
+
+            const auto numSkipped = (int) juce::jlimit ((juce::int64) 0, (juce::int64) numSamples, latency - position);
+
+            if (numSkipped < numSamples && ! writer->writeFromAudioSampleBuffer (view, numSkipped, numSamples - numSkipped))
+            {
+                result.error = "write failed at sample " + juce::String (position);
+                return result;
+            }
+        }
+
+        for (auto& processor : chain)
+            processor->releaseResources();
+
+        result.numSamples = totalNumSamples - latency;
+        result.ok = true;
+        return result;
+    }
+
+    int reportRealtimeViolations()
+    {
+        if (! RealtimeGuard::isEnabled())
+            return 0;
+
+        auto numViolations = RealtimeGuard::getNumViolations();
+
+        if (numViolations == 0)
+            return 0;
+
+        std::cerr << "realtime guard: " << numViolations << " allocation(s) on the audio thread" << std::endl;
+
+        for (auto& report : RealtimeGuard::getReports())
+            std::cerr << report << std::endl;
+
+        return 1;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args (argc, argv);
+    BatchOptions options;
+
+    if (! parseOptions (args, options))
+        return 1;
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    juce::Array<juce::File> inputFiles;
+
+    for (auto& file : options.inputDirectory.findChildFiles (juce::File::findFiles, true, "*.wav;*.flac;*.aif;*.aiff"))
+        if (! file.isAChildOf (options.outputDirectory))
+            inputFiles.add (file);
+
+    inputFiles.sort();
+
+    if (inputFiles.isEmpty())
+    {
+        std::cerr << "no WAV, FLAC or AIFF files in " << options.inputDirectory.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    std::cout << "DSP kernels: " << CpuDispatch::getIsaName (CpuDispatch::getKernels().isa) << std::endl;
+
+    // collect violations and fail at the end instead of stopping at the first assertion
+    RealtimeGuard::setAssertOnViolation (false);
+    RealtimeGuard::reset();
+
+    std::atomic<int> nextFile { 0 };
+    std::mutex outputLock;
+    int numFailed = 0;
+    juce::int64 numBytesRead = 0;
+    double audioSeconds = 0.0;
+    juce::int64 numSampleFrames = 0;
+
+    // each worker takes the next unprocessed file until there are none left
+    auto worker = [&]
+    {
+        for (;;)
+        {
+            auto index = nextFile.fetch_add (1);
+
+            if (index >= inputFiles.size())
+                return;
+
+            auto& inputFile = inputFiles.getReference (index);
+            auto outputFile = options.outputDirectory.getChildFile (inputFile.getRelativePathFrom (options.inputDirectory));
+            auto result = processFile (inputFile, outputFile, options, formatManager);
+
+            std::lock_guard<std::mutex> lock (outputLock);
+
+            if (! result.ok)
+            {
+                ++numFailed;
+                std::cerr << inputFile.getFullPathName() << ": " << result.error << std::endl;
+                continue;
+            }
+
+            numBytesRead += inputFile.getSize();
+            numSampleFrames += result.numSamples;
+            audioSeconds += (double) result.numSamples / result.sampleRate;
+        }
+    };
+
+    const int numJobs = juce::jmin (options.numJobs, inputFiles.size());
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    std::vector<std::thread> workers;
+
+    for (int i = 1; i < numJobs; ++i)
+        workers.emplace_back (worker);
+
+    worker();
+
+    for (auto& thread : workers)
+        thread.join();
+
+    const auto elapsed = juce::jmax (juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks), 1.0e-9);
+    const auto numProcessed = inputFiles.size() - numFailed;
+
+    std::cout << "processed " << numProcessed << " of " << inputFiles.size() << " files with " << numJobs
+              << " jobs in " << elapsed << " s" << std::endl
+              << "  " << numProcessed / elapsed << " files/s, "
+              << audioSeconds / elapsed << "x realtime, "
+              << (double) numSampleFrames / elapsed / 1.0e6 << " M sample frames/s, "
+              << (double) numBytesRead / elapsed / (1024.0 * 1024.0) << " MiB/s read" << std::endl;
+
+    return juce::jmax (numFailed > 0 ? 1 : 0, reportRealtimeViolations());
+}
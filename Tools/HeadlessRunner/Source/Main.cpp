@@ -0,0 +1,507 @@
+/*
+  ==============================================================================
+
+    Headless runner: renders audio offline through one of the plugins in this
+    repo, without a host or a GUI.
+
+    Build it as a console app together with the Source folder of the plugin
+    you want to run (the same way the Standalone wrapper is built), so that
+    createPluginFilter() resolves to that plugin's processor.
+
+    In debug builds every processBlock call runs under RealtimeGuard, and
+    the runner fails if anything allocated on the audio thread.
+
+    --stress drives the processor like a hostile host instead: random block
+    sizes (including 1 and odd lengths), prepareToPlay at a new sample rate
+    mid-stream, every parameter automated on every block, and input that
+    alternates between noise, tones and silence. It reports the per-block
+    time distribution (p99.9 and max are what matter for dropouts) and any
+    NaN/Inf or denormal output.
+
+    Usage:
+        HeadlessRunner [--seconds 10] [--rate 44100] [--block 512]
+                       [--trace trace.json]
+        HeadlessRunner --stress [--blocks 100000] [--block 512] [--seed 1]
+
+    In stress mode --block is the largest block size passed to prepareToPlay.
+
+    --fixed-block n runs the processor in fixed block mode (see
+    Shared/FixedBlockScheduler.h) with blocks of n samples, in any mode.
+
+    --replay plays back a capture recorded by a plugin running in a host with
+    JUCE_PROJECTS_CAPTURE_DIR set (see Shared/AutomationCapture.h): same
+    sample rate, same block sizes, same input, the same parameter changes at
+    the same block boundaries and the same blocks bypassed, so the output is
+    bit-exact and a reported spike can be profiled offline. Replays always
+    run at full quality (see Shared/QualityGovernor.h). --output writes the
+    result as a 32-bit float WAV file for comparison between builds.
+
+        HeadlessRunner --replay session.jpcap [--output replay.wav]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Shared/AutomationCapture.h"
+#include "../../../Shared/CpuDispatch.h"
+#include "../../../Shared/FixedBlockScheduler.h"
+#include "../../../Shared/ProcessorOptions.h"
+#include "../../../Shared/RealtimeGuard.h"
+#include "../../../Shared/TraceEvents.h"
+
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+namespace
+{
+    struct RenderOptions
+    {
+        double sampleRate = 44100.0;
+        int blockSize = 512;
+        double seconds = 10.0;
+        juce::File traceFile;
+
+        bool stress = false;
+        juce::int64 numStressBlocks = 100000;
+        juce::int64 seed = 1;
+
+        juce::File replayFile;
+        juce::File outputFile;
+
+        // -1 leaves the processor's own setting
+        int fixedBlockSize = -1;
+    };
+
+    RenderOptions parseOptions (const juce::ArgumentList& args)
+    {
+        RenderOptions options;
+
+        if (args.containsOption ("--rate"))
+            options.sampleRate = args.getValueForOption ("--rate").getDoubleValue();
+
+        if (args.containsOption ("--block"))
+            options.blockSize = args.getValueForOption ("--block").getIntValue();
+
+        if (args.containsOption ("--seconds"))
+            options.seconds = args.getValueForOption ("--seconds").getDoubleValue();
+
+        if (args.containsOption ("--trace"))
+            options.traceFile = args.getFileForOption ("--trace");
+
+        options.stress = args.containsOption ("--stress");
+
+        if (args.containsOption ("--blocks"))
+            options.numStressBlocks = args.getValueForOption ("--blocks").getLargeIntValue();
+
+        if (args.containsOption ("--seed"))
+            options.seed = args.getValueForOption ("--seed").getLargeIntValue();
+
+        if (args.containsOption ("--replay"))
+            options.replayFile = args.getFileForOption ("--replay");
+
+        if (args.containsOption ("--output"))
+            options.outputFile = args.getFileForOption ("--output");
+
+        if (args.containsOption ("--fixed-block"))
+            options.fixedBlockSize = args.getValueForOption ("--fixed-block").getIntValue();
+
+        return options;
+    }
+
+    void fillWithNoise (juce::AudioBuffer<float>& buffer, juce::Random& random)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            auto* data = buffer.getWritePointer (channel);
+
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                data[i] = random.nextFloat() - 0.5f;
+        }
+    }
+
+    int render (juce::AudioProcessor& processor, const RenderOptions& options)
+    {
+        const int numChannels = juce::jmax (processor.getTotalNumInputChannels(),
+                                            processor.getTotalNumOutputChannels());
+
+        processor.setNonRealtime (true);
+        processor.setRateAndBufferSizeDetails (options.sampleRate, options.blockSize);
+        processor.prepareToPlay (options.sampleRate, options.blockSize);
+
+        juce::AudioBuffer<float> buffer (numChannels, options.blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random (0x5eed);
+
+        const auto numBlocks = (juce::int64) std::ceil (options.seconds * options.sampleRate / options.blockSize);
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+
+        for (juce::int64 block = 0; block < numBlocks; ++block)
+        {
+            fillWithNoise (buffer, random);
+            processor.processBlock (buffer, midi);
+        }
+
+        const auto elapsed = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks);
+        processor.releaseResources();
+
+        const auto renderedSeconds = (double) (numBlocks * options.blockSize) / options.sampleRate;
+
+        std::cout << processor.getName() << ": rendered " << renderedSeconds << " s in "
+                  << elapsed << " s (" << renderedSeconds / juce::jmax (elapsed, 1.0e-9) << "x realtime)"
+                  << std::endl;
+
+        return 0;
+    }
+
+    //==============================================================================
+    struct StressStats
+    {
+        std::vector<double> blockMicroseconds;
+        double worstBudgetRatio = 0.0;
+        juce::int64 numNonFiniteBlocks = 0;
+        juce::int64 numDenormalBlocks = 0;
+        int numSampleRateChanges = 0;
+    };
+
+    void fillStressInput (juce::AudioBuffer<float>& buffer, int numSamples, juce::Random& random,
+                          int inputKind, double& tonePhase, double toneIncrement)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            auto* data = buffer.getWritePointer (channel);
+            auto phase = tonePhase;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                switch (inputKind)
+                {
+                    case 0:  data[i] = 2.0f * random.nextFloat() - 1.0f; break;
+                    case 1:  data[i] = (float) std::sin (phase); phase += toneIncrement; break;
+                    default: data[i] = 0.0f; break; // silence lets feedback tails decay into denormal range
+                }
+            }
+
+            if (channel == buffer.getNumChannels() - 1)
+                tonePhase = std::fmod (phase, juce::MathConstants<double>::twoPi);
+        }
+    }
+
+    void scanOutput (const juce::AudioBuffer<float>& buffer, int numSamples, StressStats& stats)
+    {
+        bool nonFinite = false, denormal = false;
+
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            auto* data = buffer.getReadPointer (channel);
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                nonFinite = nonFinite || ! std::isfinite (data[i]);
+                denormal = denormal || std::fpclassify (data[i]) == FP_SUBNORMAL;
+            }
+        }
+
+        stats.numNonFiniteBlocks += nonFinite ? 1 : 0;
+        stats.numDenormalBlocks += denormal ? 1 : 0;
+    }
+
+    double percentile (const std::vector<double>& sorted, double p)
+    {
+        if (sorted.empty())
+            return 0.0;
+
+        auto index = (size_t) juce::jlimit (0.0, (double) sorted.size() - 1.0, std::ceil (p * (double) sorted.size()) - 1.0);
+        return sorted[index];
+    }
+
+    void printBlockTimes (std::vector<double> blockMicroseconds)
+    {
+        std::sort (blockMicroseconds.begin(), blockMicroseconds.end());
+
+        std::cout << "  per-block time (us): p50 " << percentile (blockMicroseconds, 0.5)
+                  << ", p99 " << percentile (blockMicroseconds, 0.99)
+                  << ", p99.9 " << percentile (blockMicroseconds, 0.999)
+                  << ", max " << (blockMicroseconds.empty() ? 0.0 : blockMicroseconds.back()) << std::endl;
+    }
+
+    int stress (juce::AudioProcessor& processor, const RenderOptions& options)
+    {
+        static const double sampleRates[] = { 22050.0, 44100.0, 48000.0, 88200.0, 96000.0, 192000.0 };
+
+        const int numChannels = juce::jmax (processor.getTotalNumInputChannels(),
+                                            processor.getTotalNumOutputChannels());
+        const int maxBlockSize = options.blockSize;
+
+        juce::Random random (options.seed);
+        juce::AudioBuffer<float> buffer (numChannels, maxBlockSize);
+        juce::MidiBuffer midi;
+        auto& parameters = processor.getParameters();
+
+        StressStats stats;
+        stats.blockMicroseconds.reserve ((size_t) options.numStressBlocks);
+
+        double sampleRate = options.sampleRate;
+        juce::int64 blocksUntilRateChange = 0;
+        juce::int64 blocksUntilInputChange = 0;
+        int inputKind = 0;
+        double tonePhase = 0.0, toneIncrement = 0.0;
+
+        processor.setNonRealtime (false);
+
+        for (juce::int64 block = 0; block < options.numStressBlocks; ++block)
+        {
+            if (blocksUntilRateChange-- <= 0)
+            {
+                if (block > 0)
+                {
+                    processor.releaseResources();
+                    sampleRate = sampleRates[random.nextInt (juce::numElementsInArray (sampleRates))];
+                    ++stats.numSampleRateChanges;
+                }
+
+                processor.setRateAndBufferSizeDetails (sampleRate, maxBlockSize);
+                processor.prepareToPlay (sampleRate, maxBlockSize);
+                blocksUntilRateChange = 500 + random.nextInt (5000);
+            }
+
+            if (blocksUntilInputChange-- <= 0)
+            {
+                inputKind = random.nextInt (3);
+                toneIncrement = juce::MathConstants<double>::twoPi * (20.0 + 10000.0 * random.nextDouble()) / sampleRate;
+                blocksUntilInputChange = 10 + random.nextInt (2000);
+            }
+
+            int numSamples;
+
+            switch (random.nextInt (8))
+            {
+                case 0:  numSamples = 1; break;
+                case 1:  numSamples = juce::jmin (maxBlockSize, 1 + 2 * random.nextInt (juce::jmax (1, maxBlockSize / 2))); break;
+                case 2:  numSamples = maxBlockSize; break;
+                default: numSamples = 1 + random.nextInt (maxBlockSize); break;
+            }
+
+            // automation storm: every parameter moves on every block, discrete ones flip modes
+            for (auto* parameter : parameters)
+                parameter->setValue (random.nextFloat());
+
+            fillStressInput (buffer, numSamples, random, inputKind, tonePhase, toneIncrement);
+            juce::AudioBuffer<float> view (buffer.getArrayOfWritePointers(), numChannels, numSamples);
+
+            const auto startTicks = juce::Time::getHighResolutionTicks();
+            processor.processBlock (view, midi);
+            const auto seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks);
+
+            stats.blockMicroseconds.push_back (seconds * 1.0e6);
+            stats.worstBudgetRatio = juce::jmax (stats.worstBudgetRatio, seconds * sampleRate / numSamples);
+            scanOutput (view, numSamples, stats);
+        }
+
+        processor.releaseResources();
+
+        std::cout << processor.getName() << ": " << stats.blockMicroseconds.size() << " blocks, "
+                  << stats.numSampleRateChanges << " sample-rate changes" << std::endl;
+
+        printBlockTimes (stats.blockMicroseconds);
+
+        std::cout << "  worst block used " << stats.worstBudgetRatio * 100.0 << "% of its real-time budget" << std::endl
+                  << "  blocks with NaN/Inf output: " << stats.numNonFiniteBlocks << std::endl
+                  << "  blocks with denormal output: " << stats.numDenormalBlocks << std::endl;
+
+        return stats.numNonFiniteBlocks > 0 ? 1 : 0;
+    }
+
+    //==============================================================================
+    int replay (juce::AudioProcessor& processor, const RenderOptions& options)
+    {
+        AutomationCaptureReader reader;
+
+        if (! reader.open (options.replayFile))
+        {
+            std::cerr << "not a capture file: " << options.replayFile.getFullPathName() << std::endl;
+            return 1;
+        }
+
+        auto& parameters = processor.getParameters();
+
+        if (reader.numParameters != parameters.size())
+        {
+            std::cerr << "capture has " << reader.numParameters << " parameters, "
+                      << processor.getName() << " has " << parameters.size() << std::endl;
+            return 1;
+        }
+
+        for (int i = 0; i < parameters.size(); ++i)
+            if (reader.parameterIDs[i] != AutomationCaptureFormat::getParameterID (*parameters[i]))
+                std::cerr << "warning: parameter " << i << " was '" << reader.parameterIDs[i] << "' in the capture" << std::endl;
+
+        const int numChannels = juce::jmax (processor.getTotalNumInputChannels(),
+                                            processor.getTotalNumOutputChannels());
+
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+
+        if (options.outputFile != juce::File())
+        {
+            options.outputFile.deleteFile();
+
+            if (auto stream = options.outputFile.createOutputStream())
+            {
+                juce::WavAudioFormat wav;
+                writer.reset (wav.createWriterFor (stream.get(), reader.sampleRate, (unsigned int) numChannels, 32, {}, 0));
+
+                if (writer != nullptr)
+                    stream.release(); // now owned by the writer
+            }
+
+            if (writer == nullptr)
+            {
+                std::cerr << "could not write " << options.outputFile.getFullPathName() << std::endl;
+                return 1;
+            }
+        }
+
+        juce::AudioBuffer<float> buffer (numChannels, reader.maxBlockSize);
+        juce::MidiBuffer midi;
+        std::vector<double> blockMicroseconds;
+        AutomationCaptureReader::Record record;
+        bool reachedEnd = false;
+        bool prepared = false;
+
+        while (reader.readNextRecord (record))
+        {
+            if (record.type == AutomationCaptureFormat::endRecord)
+            {
+                reachedEnd = true;
+                break;
+            }
+
+            if (record.type == AutomationCaptureFormat::parameterRecord)
+            {
+                if (juce::isPositiveAndBelow ((int) record.parameterIndex, parameters.size()))
+                    parameters[record.parameterIndex]->setValue (record.parameterValue);
+
+                continue;
+            }
+
+            // prepared only now, after the initial parameter values, because
+            // prepareToPlay snapshots some of them (e.g. Delay's smoothed delay time)
+            if (! prepared)
+            {
+                // non-realtime keeps the quality governor at full quality, so the
+                // output doesn't depend on how fast this machine is
+                processor.setNonRealtime (true);
+                processor.setRateAndBufferSizeDetails (reader.sampleRate, reader.maxBlockSize);
+                processor.prepareToPlay (reader.sampleRate, reader.maxBlockSize);
+                prepared = true;
+            }
+
+            buffer.clear();
+
+            if (! reader.readBlock (buffer, record.numSamples))
+                break;
+
+            juce::AudioBuffer<float> view (buffer.getArrayOfWritePointers(), numChannels, record.numSamples);
+
+            const auto startTicks = juce::Time::getHighResolutionTicks();
+            if (record.bypassed)
+                processor.processBlockBypassed (view, midi);
+            else
+                processor.processBlock (view, midi);
+
+            blockMicroseconds.push_back (juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks) * 1.0e6);
+
+            if (writer != nullptr)
+                writer->writeFromAudioSampleBuffer (view, 0, record.numSamples);
+        }
+
+        if (prepared)
+            processor.releaseResources();
+
+        writer.reset();
+
+        std::cout << processor.getName() << ": replayed " << blockMicroseconds.size() << " blocks at "
+                  << reader.sampleRate << " Hz" << std::endl;
+
+        printBlockTimes (blockMicroseconds);
+
+        if (! reachedEnd)
+        {
+            std::cerr << "capture ended early (truncated or still being written)" << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    int reportRealtimeViolations()
+    {
+        if (! RealtimeGuard::isEnabled())
+            return 0;
+
+        auto numViolations = RealtimeGuard::getNumViolations();
+
+        if (numViolations == 0)
+        {
+            std::cout << "realtime guard: no allocations on the audio thread" << std::endl;
+            return 0;
+        }
+
+        std::cerr << "realtime guard: " << numViolations << " allocation(s) on the audio thread" << std::endl;
+
+        for (auto& report : RealtimeGuard::getReports())
+            std::cerr << report << std::endl;
+
+        return 1;
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args (argc, argv);
+    auto options = parseOptions (args);
+
+    if (options.sampleRate <= 0.0 || options.blockSize <= 0 || options.seconds <= 0.0 || options.numStressBlocks <= 0)
+    {
+        std::cerr << "invalid --rate, --block, --seconds or --blocks" << std::endl;
+        return 1;
+    }
+
+    if (options.fixedBlockSize >= 0 && ! FixedBlockScheduler::isValidBlockSize (options.fixedBlockSize))
+    {
+        std::cerr << "invalid --fixed-block: 0 or a power of two from " << FixedBlockScheduler::minBlockSize
+                  << " to " << FixedBlockScheduler::maxBlockSize << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<juce::AudioProcessor> processor (createPluginFilter());
+
+    if (options.fixedBlockSize >= 0)
+    {
+        if (auto* withOptions = dynamic_cast<ProcessorOptions*> (processor.get()))
+            withOptions->setFixedBlockSize (options.fixedBlockSize);
+        else
+            std::cerr << "--fixed-block ignored: " << processor->getName() << " has no fixed block mode" << std::endl;
+    }
+    std::cout << "DSP kernels: " << CpuDispatch::getIsaName (CpuDispatch::getKernels().isa) << std::endl;
+
+    // collect violations and fail at the end instead of stopping at the first assertion
+    RealtimeGuard::setAssertOnViolation (false);
+    RealtimeGuard::reset();
+
+    auto result = options.replayFile != juce::File() ? replay (*processor, options)
+                : options.stress                    ? stress (*processor, options)
+                                                    : render (*processor, options);
+
+    if (options.traceFile != juce::File())
+    {
+        if (! TraceEvents::isEnabled())
+            std::cerr << "--trace ignored: build with JUCE_PROJECTS_TRACING=1" << std::endl;
+        else if (! TraceEvents::writeChromeTrace (options.traceFile))
+            std::cerr << "could not write " << options.traceFile.getFullPathName() << std::endl;
+        else
+            std::cout << "wrote trace to " << options.traceFile.getFullPathName() << std::endl;
+    }
+
+    return juce::jmax (result, reportRealtimeViolations());
+}